@@ -10,7 +10,24 @@
 #include <atta/file/interface.h>
 #include <atta/graphics/interface.h>
 #include <atta/resource/interface.h>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
 #include <random>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 std::array<atta::vec3, Project::COLOR_SHADING_COUNT> Project::_colorShadingError = {
     // {R_gain, G_gain, B_gain} // Distance from center (Index 0 = center, Index N = corner)
@@ -26,6 +43,188 @@ std::array<atta::vec3, Project::COLOR_SHADING_COUNT> Project::_colorShadingError
     atta::vec3{1.200f, 0.800f, 1.200f}  // Index 9 (Corner - strong magenta cast)
 };
 
+namespace {
+// x^(num/den) for x in [0, 1], using Newton iterations on y^den = x^num so it can be evaluated at compile time
+constexpr double constexprPow(double x, int num, int den) {
+    double target = 1.0;
+    for (int i = 0; i < num; i++)
+        target *= x;
+    double y = 1.0;
+    for (int iter = 0; iter < 100; iter++) {
+        double yPow = 1.0;
+        for (int i = 0; i < den - 1; i++)
+            yPow *= y;
+        if (yPow <= 0.0)
+            break;
+        y -= (yPow * y - target) / (den * yPow);
+    }
+    return y;
+}
+
+// 8-bit sRGB encoding curve (linear to sRGB)
+constexpr std::array<uint8_t, 256> makeSrgbCurve() {
+    std::array<uint8_t, 256> curve{};
+    for (int i = 0; i < 256; i++) {
+        double x = i / 255.0;
+        double y = x <= 0.0031308 ? 12.92 * x : 1.055 * constexprPow(x, 5, 12) - 0.055;
+        curve[i] = uint8_t(y * 255.0 + 0.5);
+    }
+    return curve;
+}
+constexpr std::array<uint8_t, 256> SRGB_CURVE = makeSrgbCurve();
+
+// Whether the thread is running a range of a parallel loop (or a serial section), in which case nested parallel loops run serially
+thread_local bool parallelWorker = false;
+
+// Color channels of a frame with ch channels. The alpha channel of RGBA frames is not a color value, so the color stages copy it and the warp
+// stages resample it with the pixel
+constexpr uint32_t colorChannels(uint32_t ch) {
+    return ch == 4 ? 3 : ch;
+}
+
+// Channel whose parameters (gains, curves) are used for color channel c. Mono frames are processed as the green channel
+constexpr uint32_t parameterChannel(uint32_t ch, uint32_t c) {
+    return ch == 1 ? 1 : c;
+}
+
+// Calls func with value as a compile-time constant (std::integral_constant). Nothing is called if value is not one of VALUES
+template <typename T, T... VALUES, typename Func>
+void dispatchValue(T value, Func&& func) {
+    ((value == VALUES ? func(std::integral_constant<T, VALUES>()) : void()), ...);
+}
+
+// Calls func(CH, step) with the number of channels (1, 3 or 4) and the distance between horizontally adjacent values of a channel as
+// compile-time constants, so the runtime dispatch happens once per stage call and the pixel loops have constant strides and are unrolled over
+// the channels. For planar buffers the step is 1, so the loops over a plane row are contiguous and can be vectorized
+template <typename Func>
+void dispatchLayout(bool planar, uint32_t ch, Func&& func) {
+    dispatchValue<uint32_t, 1, 3, 4>(ch, [&](auto CH) {
+        if (planar)
+            func(CH, std::integral_constant<uint32_t, 1>());
+        else
+            func(CH, CH);
+    });
+}
+
+// Calls func with the interpolation mode (Project::Interpolation) as a compile-time constant
+template <typename Mode, typename Func>
+void dispatchInterpolation(Mode mode, Func&& func) {
+    dispatchValue<Mode, Mode::NEAREST, Mode::BILINEAR>(mode, func);
+}
+
+// Row kernels of the non-local means filter. With GCC (12 or later, for __builtin_shufflevector) and Clang they use generic vector types
+// (vector extensions), compiled to SSE/AVX on x86 and to NEON on ARM, and the values after the last full vector are processed one at a time.
+// Other compilers only run the scalar loops
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 12)
+#define ROW_KERNELS_SIMD 1
+using U8x16 = uint8_t __attribute__((vector_size(16)));
+using U16x16 = uint16_t __attribute__((vector_size(32)));
+using U32x16 = uint32_t __attribute__((vector_size(64)));
+using F32x16 = float __attribute__((vector_size(64)));
+constexpr uint32_t SIMD_WIDTH = 16; // Values per vector
+
+// Adds to v its values moved up by S lanes (lane i gets v[i] + v[i - S], the first S lanes are unchanged)
+template <uint32_t S, size_t... I>
+void addShiftedLanes(U32x16& v, std::index_sequence<I...>) {
+    v += __builtin_shufflevector(U32x16{}, v, (SIMD_WIDTH - S + I)...);
+}
+template <uint32_t S>
+void addShiftedLanes(U32x16& v) {
+    addShiftedLanes<S>(v, std::make_index_sequence<SIMD_WIDTH>());
+}
+#endif
+
+// out[x] = (a[x] - b[x])^2, added to out[x] if accumulate
+void squaredDifferenceRow(const uint8_t* a, const uint8_t* b, uint32_t* out, uint32_t n, bool accumulate) {
+    uint32_t x = 0;
+#ifdef ROW_KERNELS_SIMD
+    for (; x + SIMD_WIDTH <= n; x += SIMD_WIDTH) {
+        U8x16 va, vb;
+        U32x16 sum;
+        std::memcpy(&va, a + x, sizeof(va));
+        std::memcpy(&vb, b + x, sizeof(vb));
+        // The square of the difference of two bytes fits in 16 bits, so it is computed modulo 2^16
+        const U16x16 d = __builtin_convertvector(va, U16x16) - __builtin_convertvector(vb, U16x16);
+        const U32x16 square = __builtin_convertvector(d * d, U32x16);
+        if (accumulate) {
+            std::memcpy(&sum, out + x, sizeof(sum));
+            sum += square;
+        } else {
+            sum = square;
+        }
+        std::memcpy(out + x, &sum, sizeof(sum));
+    }
+#endif
+    for (; x < n; x++) {
+        const int d = int(a[x]) - int(b[x]);
+        out[x] = (accumulate ? out[x] : 0) + uint32_t(d * d);
+    }
+}
+
+// out[x] = in[x] + ... + in[x + size - 1], as a sliding sum: out[x] = out[x - 1] + in[x + size - 1] - in[x - 1]. The sums are modulo 2^32,
+// so they are exact whatever the order of the additions and subtractions
+void boxFilterRow(const uint32_t* in, uint32_t* out, uint32_t n, uint32_t size) {
+    if (n == 0)
+        return;
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < size; k++)
+        sum += in[k];
+    out[0] = sum;
+    uint32_t x = 1;
+#ifdef ROW_KERNELS_SIMD
+    // Differences between consecutive outputs, added up by a prefix sum inside the vector, starting from the last output of the previous one
+    for (; x + SIMD_WIDTH <= n; x += SIMD_WIDTH) {
+        U32x16 added, removed;
+        std::memcpy(&added, in + x + size - 1, sizeof(added));
+        std::memcpy(&removed, in + x - 1, sizeof(removed));
+        U32x16 delta = added - removed;
+        addShiftedLanes<1>(delta);
+        addShiftedLanes<2>(delta);
+        addShiftedLanes<4>(delta);
+        addShiftedLanes<8>(delta);
+        delta += out[x - 1];
+        std::memcpy(out + x, &delta, sizeof(delta));
+    }
+#endif
+    for (; x < n; x++)
+        out[x] = out[x - 1] + in[x + size - 1] - in[x - 1];
+}
+
+// Add weight[x] to sumWeight[x], keep the largest weight in maxWeight[x] and add weight[x] * values[c][x] to plane c of sumValue
+template <uint32_t NC>
+void accumulateWeightsRow(const float* weight, const std::array<const uint8_t*, NC>& values, float* sumWeight, float* maxWeight, float* sumValue,
+                          size_t planeSize, uint32_t n) {
+    uint32_t x = 0;
+#ifdef ROW_KERNELS_SIMD
+    for (; x + SIMD_WIDTH <= n; x += SIMD_WIDTH) {
+        F32x16 wt, sw, mw, sv;
+        U8x16 value;
+        std::memcpy(&wt, weight + x, sizeof(wt));
+        std::memcpy(&sw, sumWeight + x, sizeof(sw));
+        std::memcpy(&mw, maxWeight + x, sizeof(mw));
+        sw += wt;
+        mw = mw < wt ? wt : mw;
+        std::memcpy(sumWeight + x, &sw, sizeof(sw));
+        std::memcpy(maxWeight + x, &mw, sizeof(mw));
+        for (uint32_t c = 0; c < NC; c++) {
+            std::memcpy(&value, values[c] + x, sizeof(value));
+            std::memcpy(&sv, sumValue + c * planeSize + x, sizeof(sv));
+            sv += wt * __builtin_convertvector(value, F32x16);
+            std::memcpy(sumValue + c * planeSize + x, &sv, sizeof(sv));
+        }
+    }
+#endif
+    for (; x < n; x++) {
+        sumWeight[x] += weight[x];
+        maxWeight[x] = std::max(maxWeight[x], weight[x]);
+        for (uint32_t c = 0; c < NC; c++)
+            sumValue[c * planeSize + x] += weight[x] * values[c][x];
+    }
+}
+} // namespace
+
+thread_local const Project::CameraModule* Project::_threadCamera = nullptr;
+
 void Project::onLoad() {
     // Default image info
     res::Image::CreateInfo info;
@@ -33,32 +232,112 @@ void Project::onLoad() {
     info.height = 100;
     info.format = res::Image::Format::RGB8;
 
+    // Test images (every image in the resources directory)
+    const fs::path resourcePath = fil::getProject()->getResourceRootPaths()[0];
+    const std::array<std::string, 7> extensions = {".png", ".jpg", ".ppm", ".pgm", ".y4m", ".raw", ".yuv"};
+    std::error_code error;
+    for (const fs::directory_entry& entry : fs::directory_iterator(resourcePath, error))
+        if (entry.is_regular_file() && std::find(extensions.begin(), extensions.end(), entry.path().extension().string()) != extensions.end())
+            _testImages.push_back(entry.path().filename().string());
+    std::sort(_testImages.begin(), _testImages.end());
+    auto defaultImage = std::find(_testImages.begin(), _testImages.end(), "taiwan.png");
+    _selectedImage = defaultImage == _testImages.end() ? 0 : int(defaultImage - _testImages.begin());
+
     // Images to store output of each pipeline stage
     res::Image* ref = res::create<res::Image>("reference", info);
-    fs::path imagePath = fil::getProject()->getResourceRootPaths()[0] / "taiwan.png";
-    ref->load(imagePath);
+    createThumbnail("reference");
+    openInput(resourcePath / "taiwan.png");
     info.width = ref->getWidth();
     info.height = ref->getHeight();
 
-    // Image degradation pipeline
-    res::create<res::Image>("deg_white_balance", info);
-    res::create<res::Image>("deg_lens", info);
-    res::create<res::Image>("deg_color_shading", info);
-    res::create<res::Image>("deg_chromatic_aberration", info);
-    res::create<res::Image>("deg_vignetting", info);
-    res::create<res::Image>("deg_black_level", info);
-    res::create<res::Image>("deg_dead_pixel", info);
-    res::create<res::Image>("deg_output", info);
-
-    // Image processing pipeline
-    res::create<res::Image>("pro_dead_pixel", info);
-    res::create<res::Image>("pro_black_level", info);
-    res::create<res::Image>("pro_vignetting", info);
-    res::create<res::Image>("pro_chromatic_aberration", info);
-    res::create<res::Image>("pro_color_shading", info);
-    res::create<res::Image>("pro_lens", info);
-    res::create<res::Image>("pro_white_balance", info);
-    res::create<res::Image>("pro_output", info);
+    // Pipeline stages (image degradation followed by image processing)
+    _stages = {
+        {"deg_white_balance", &Project::degWhiteBalanceError, nullptr},
+        {"deg_lens", &Project::degLensDistortion, &Project::degLensHalo},
+        {"deg_color_shading", &Project::degColorShadingError, nullptr},
+        {"deg_chromatic_aberration", &Project::degChromaticAberrationError, &Project::degChromaticAberrationHalo},
+        {"deg_vignetting", &Project::degVignettingError, nullptr},
+        {"deg_sensor_noise", &Project::degSensorNoise, nullptr},
+        {"deg_black_level", &Project::degBlackLevelOffset, nullptr},
+        {"deg_dead_pixel", &Project::degDeadPixelInjection, nullptr},
+        {"deg_output", &Project::copyStage, nullptr},
+        {"pro_dead_pixel", &Project::proDeadPixelCorrection, &Project::deadPixelHalo},
+        {"pro_black_level", &Project::proBlackLevelCorrection, nullptr},
+        {"pro_noise_reduction", &Project::proNoiseReduction, &Project::noiseReductionHalo},
+        {"pro_lens_shading", &Project::proLensShadingCorrection, nullptr},
+        {"pro_chromatic_aberration", &Project::proChromaticAberrationCorrection, &Project::proChromaticAberrationHalo},
+        {"pro_lens", &Project::proLensCorrection, &Project::proLensHalo},
+        {"pro_white_balance", &Project::proWhiteBalanceCorrection, nullptr}, // Or proWhiteBalanceCorrectionAuto (automatic white balance)
+        {"pro_color", &Project::proColorCorrection, nullptr},
+        {"pro_output", &Project::copyStage, nullptr},
+    };
+    for (const Stage& stage : _stages)
+        createStageImage(stage.name, info.width, info.height);
+
+    // Calibrated correction profile
+    fs::path profilePath = fil::getProject()->getResourceRootPaths()[0].parent_path() / "calibration_profile.txt";
+    if (fs::exists(profilePath) && loadCalibrationProfile(profilePath, _camera))
+        _camera.useCalibration = true;
+}
+
+void Project::createStageImage(const std::string& name, uint32_t w, uint32_t h) {
+    res::Image::CreateInfo info;
+    info.width = w;
+    info.height = h;
+    info.format = res::Image::Format::RGB8;
+    res::create<res::Image>(name, info);
+    createThumbnail(name);
+    _stageNames.push_back(name);
+}
+
+void Project::createThumbnail(const std::string& name) {
+    res::Image* img = res::get<res::Image>(name);
+
+    // Keep aspect ratio while limiting the largest dimension
+    float scale = std::min(1.0f, float(THUMBNAIL_MAX_SIZE) / float(std::max(img->getWidth(), img->getHeight())));
+    res::Image::CreateInfo info;
+    info.width = std::max(1u, uint32_t(std::round(img->getWidth() * scale)));
+    info.height = std::max(1u, uint32_t(std::round(img->getHeight() * scale)));
+    info.format = img->getFormat();
+    res::Image* thumb = res::get<res::Image>(name + "_thumb");
+    if (thumb != nullptr && thumb->getWidth() == info.width && thumb->getHeight() == info.height)
+        return;
+    if (thumb == nullptr)
+        res::create<res::Image>(name + "_thumb", info);
+    else
+        thumb->resize(info.width, info.height);
+    _stageDisplay[name] = StageDisplay{};
+}
+
+void Project::invalidateStages(const std::string& firstStage) {
+    size_t first = 0;
+    while (!firstStage.empty() && first < _stages.size() && _stages[first].name != firstStage)
+        first++;
+    _firstDirtyStage = std::min(_firstDirtyStage, first);
+    _referenceDirty |= firstStage.empty();
+    _shouldReprocess = true;
+}
+
+void Project::updateStageDisplay(const std::string& name, bool thumbnailReady) {
+    res::Image* img = res::get<res::Image>(name);
+    uint32_t ch = img->getChannels();
+    _stageDisplay[name].fullUploaded = false;
+
+    // Upload thumbnail
+    res::Image* thumb = res::get<res::Image>(name + "_thumb");
+    if (!thumbnailReady)
+        downscaleImage(img->getData(), img->getWidth(), img->getHeight(), thumb->getData(), thumb->getWidth(), thumb->getHeight(), ch);
+    thumb->update();
+}
+
+void Project::uploadFocusedStage() {
+    if (_focusedStage.empty())
+        return;
+    StageDisplay& display = _stageDisplay[_focusedStage];
+    if (!display.fullUploaded) {
+        res::get<res::Image>(_focusedStage)->update();
+        display.fullUploaded = true;
+    }
 }
 
 void plotImage(const char* label, ImTextureID img, float x, float y, float w, float h) {
@@ -66,63 +345,91 @@ void plotImage(const char* label, ImTextureID img, float x, float y, float w, fl
     ImPlot::PlotText(label, x + 0.5f, y + h + 0.05f);
 }
 
+void Project::plotStage(const char* label, const std::string& name, float x, float y, float w, float h) {
+    bool full = name == _focusedStage && _stageDisplay[name].fullUploaded;
+    ImTextureID img = (ImTextureID)gfx::getImGuiImage(full ? name : name + "_thumb");
+    plotImage(!full && stageStale(name) ? (std::string(label) + " (stale)").c_str() : label, img, x, y, w, h);
+    _plotRects.push_back({name, x, y, w, h});
+}
+
+bool Project::stageStale(const std::string& name) const {
+    // Region reprocesses leave the changed stages to the next whole frame reprocess, the stages before the first changed one are up to date
+    if (!_roiPartial)
+        return false;
+    if (_referenceDirty)
+        return true;
+    for (size_t s = _firstDirtyStage; s < _stages.size(); s++)
+        if (_stages[s].name == name)
+            return true;
+    return false;
+}
+
 void Project::onUIRender() {
 
     ImGui::SetNextWindowSize({500, 750}, ImGuiCond_FirstUseEver);
     if (ImGui::Begin("Camera setup")) {
         if (ImGui::CollapsingHeader("White balance error", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
             if (ImGui::SliderFloat("Color temperature (K)", &_colorTemperature, 2500.0f, 10000.0f, "%.0f K"))
-                _shouldReprocess = true;
+                invalidateStages("deg_white_balance");
         }
 
         if (ImGui::CollapsingHeader("Barrel lens distortion", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Text("Barrel distortion coefficients");
             if (ImGui::SliderFloat("k1", &_barrelDistortionCoeffs[0], -1.0f, 1.0f))
-                _shouldReprocess = true;
+                invalidateStages("deg_lens");
             if (ImGui::SliderFloat("k2", &_barrelDistortionCoeffs[1], -1.0f, 1.0f))
-                _shouldReprocess = true;
+                invalidateStages("deg_lens");
             if (ImGui::SliderFloat("k3", &_barrelDistortionCoeffs[2], -1.0f, 1.0f))
-                _shouldReprocess = true;
+                invalidateStages("deg_lens");
         }
 
         if (ImGui::CollapsingHeader("Color shading error", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Text("Color shading coefficients");
             for (size_t i = 0; i < _colorShadingError.size(); i++)
                 if (ImGui::SliderFloat3(std::to_string(i).c_str(), &_colorShadingError[i].x, 0.5f, 1.5f))
-                    _shouldReprocess = true;
+                    invalidateStages("deg_color_shading");
         }
 
         if (ImGui::CollapsingHeader("Chromatic aberration", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Text("Chromatic aberration coefficients");
             if (ImGui::SliderFloat("a (R)", &_chromaticAberrationCoeffsR[0], -0.02f, 0.02f))
-                _shouldReprocess = true;
+                invalidateStages("deg_chromatic_aberration");
             if (ImGui::SliderFloat("b (R)", &_chromaticAberrationCoeffsR[1], -0.02f, 0.02f))
-                _shouldReprocess = true;
+                invalidateStages("deg_chromatic_aberration");
             if (ImGui::SliderFloat("a (B)", &_chromaticAberrationCoeffsB[0], -0.02f, 0.02f))
-                _shouldReprocess = true;
+                invalidateStages("deg_chromatic_aberration");
             if (ImGui::SliderFloat("b (B)", &_chromaticAberrationCoeffsB[1], -0.02f, 0.02f))
-                _shouldReprocess = true;
+                invalidateStages("deg_chromatic_aberration");
         }
 
         if (ImGui::CollapsingHeader("Vignetting error", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Text("Vignetting coefficients");
             if (ImGui::SliderFloat("a", &_vignettingCoeffs[0], -1.0f, 1.0f))
-                _shouldReprocess = true;
+                invalidateStages("deg_vignetting");
             if (ImGui::SliderFloat("b", &_vignettingCoeffs[1], -1.0f, 1.0f))
-                _shouldReprocess = true;
+                invalidateStages("deg_vignetting");
             if (ImGui::SliderFloat("c", &_vignettingCoeffs[2], -1.0f, 1.0f))
-                _shouldReprocess = true;
+                invalidateStages("deg_vignetting");
             if (ImGui::SliderFloat("d", &_vignettingCoeffs[3], -1.0f, 1.0f))
-                _shouldReprocess = true;
+                invalidateStages("deg_vignetting");
             if (ImGui::SliderFloat("e", &_vignettingCoeffs[4], -1.0f, 1.0f))
-                _shouldReprocess = true;
+                invalidateStages("deg_vignetting");
+        }
+
+        if (ImGui::CollapsingHeader("Sensor noise", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
+            if (ImGui::SliderFloat("Shot noise gain", &_shotNoiseGain, 0.0f, 2.0f))
+                invalidateStages("deg_sensor_noise");
+            if (ImGui::SliderFloat("Read noise", &_readNoise, 0.0f, 10.0f))
+                invalidateStages("deg_sensor_noise");
+            if (ImGui::InputInt("Seed", &_sensorNoiseSeed))
+                invalidateStages("deg_sensor_noise");
         }
 
         if (ImGui::CollapsingHeader("Black level offset", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
             int blackLevelOffset = (int)_blackLevelOffset;
             if (ImGui::SliderInt("Black level offset##BLO", &blackLevelOffset, 0, 50)) {
                 _blackLevelOffset = (uint8_t)blackLevelOffset;
-                _shouldReprocess = true;
+                invalidateStages("deg_black_level");
             }
         }
 
@@ -130,12 +437,352 @@ void Project::onUIRender() {
             float percentDeadPixels = _percentDeadPixels * 100.0f;
             if (ImGui::SliderFloat("Percent of dead pixels", &percentDeadPixels, 0.0f, 1.0f, "%.2f%%")) {
                 _percentDeadPixels = percentDeadPixels / 100.0f;
-                _shouldReprocess = true;
+                invalidateStages("deg_dead_pixel");
             }
         }
     }
     ImGui::End();
 
+    ImGui::SetNextWindowSize({500, 400}, ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Processing setup")) {
+        if (ImGui::Checkbox("Planar frame layout", &_planarLayout))
+            invalidateStages();
+        const char* channels[] = {"Mono", "RGB", "RGBA"};
+        const std::array<uint32_t, 3> channelCounts = {1, 3, 4};
+        int channelsIdx = int(std::find(channelCounts.begin(), channelCounts.end(), _frameChannels) - channelCounts.begin());
+        if (ImGui::Combo("Frame channels", &channelsIdx, channels, 3)) {
+            _frameChannels = channelCounts[channelsIdx];
+            invalidateStages();
+        }
+        const char* interpolations[] = {"Nearest", "Bilinear"};
+        int interpolation = int(_interpolation);
+        if (ImGui::Combo("Interpolation", &interpolation, interpolations, 2)) {
+            _interpolation = Interpolation(interpolation);
+            invalidateStages("deg_lens");
+        }
+
+        if (ImGui::CollapsingHeader("Noise reduction", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
+            const char* modes[] = {"None", "Bilateral grid", "Non-local means"};
+            int mode = int(_noiseReductionMode);
+            if (ImGui::Combo("Mode##NR", &mode, modes, 3)) {
+                _noiseReductionMode = NoiseReductionMode(mode);
+                invalidateStages("pro_noise_reduction");
+            }
+            if (ImGui::SliderFloat("Strength##NR", &_noiseReductionStrength, 1.0f, 50.0f, "%.1f"))
+                invalidateStages("pro_noise_reduction");
+            if (ImGui::SliderInt("Quality##NR", &_noiseReductionQuality, 1, NOISE_REDUCTION_QUALITY_MAX))
+                invalidateStages("pro_noise_reduction");
+            ImGui::Text("Last run: %.2f ms", _noiseReductionTime);
+
+            if (ImGui::Button("Benchmark##NR"))
+                benchmarkNoiseReduction();
+            if (ImGui::BeginTable("Noise reduction benchmark", NOISE_REDUCTION_QUALITY_MAX + 1, ImGuiTableFlags_Borders)) {
+                ImGui::TableSetupColumn("Mode (ms)");
+                for (int q = 1; q <= NOISE_REDUCTION_QUALITY_MAX; q++)
+                    ImGui::TableSetupColumn(("Q" + std::to_string(q)).c_str());
+                ImGui::TableHeadersRow();
+                for (int m = 0; m < 2; m++) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", modes[m + 1]);
+                    for (int q = 0; q < NOISE_REDUCTION_QUALITY_MAX; q++) {
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.1f", _noiseReductionBenchmark[m][q]);
+                    }
+                }
+                ImGui::EndTable();
+            }
+        }
+        if (ImGui::CollapsingHeader("Scaler", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
+            if (ImGui::Checkbox("Scaled outputs", &_scalerEnabled))
+                invalidateStages(_scalerStage);
+            for (ScalerOutput& output : _scalerOutputs) {
+                if (output.name.empty()) {
+                    ImGui::Text("Thumbnails: %ux%u", output.w, output.h);
+                    continue;
+                }
+                ImGui::PushID(output.name.c_str());
+                int maxSize = int(output.maxSize);
+                if (ImGui::SliderInt("Max size", &maxSize, 16, 4096)) {
+                    output.maxSize = uint32_t(maxSize);
+                    invalidateStages(_scalerStage);
+                }
+                ImGui::SameLine();
+                ImGui::Text("%s: %ux%u", output.name.c_str(), output.w, output.h);
+                ImGui::PopID();
+            }
+            ImGui::Text("Last run: %.2f ms", _scalerTime);
+            if (stageStale(_scalerStage))
+                ImGui::Text("Scaled outputs and thumbnails are stale (visible region evaluation), zoom out to update them");
+        }
+        if (ImGui::CollapsingHeader("Color correction", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
+            ImGui::Text("Color correction matrix");
+            for (int r = 0; r < 3; r++)
+                if (ImGui::SliderFloat3(("##CCM" + std::to_string(r)).c_str(), &_colorCorrectionMatrix[r * 3], -2.0f, 2.0f))
+                    _colorLutDirty = true;
+
+            const char* curves[] = {"Linear", "sRGB", "Gamma"};
+            int curve = int(_transferCurve);
+            if (ImGui::Combo("Transfer curve", &curve, curves, 3)) {
+                _transferCurve = TransferCurve(curve);
+                _colorLutDirty = true;
+            }
+            if (_transferCurve == TransferCurve::GAMMA && ImGui::SliderFloat("Gamma", &_gamma, 1.0f, 3.0f))
+                _colorLutDirty = true;
+            if (ImGui::SliderFloat("Tone contrast", &_toneContrast, -1.0f, 1.0f))
+                _colorLutDirty = true;
+
+            const char* sizes[] = {"17", "33", "65"};
+            int size = _colorLutSize == 17 ? 0 : (_colorLutSize == 33 ? 1 : 2);
+            if (ImGui::Combo("LUT size", &size, sizes, 3)) {
+                _colorLutSize = std::stoi(sizes[size]);
+                _colorLutDirty = true;
+            }
+
+            static char lutPath[256] = "";
+            ImGui::InputText("LUT file (.cube)", lutPath, sizeof(lutPath));
+            if (ImGui::Button("Load LUT") && loadColorLut(lutPath))
+                invalidateStages("pro_color");
+            ImGui::SameLine();
+            if (ImGui::Button("Use parameters")) {
+                _colorLutFile.clear();
+                _colorLutDirty = true;
+            }
+
+            const char* modes[] = {"Identity", "1D LUT (compile-time sRGB)", "1D LUT", "3D LUT"};
+            ImGui::Text("Active path: %s", modes[int(_colorLutMode)]);
+            if (_colorLutMode == ColorLutMode::LUT_3D)
+                ImGui::Text("3D LUT: %u^3%s%s", _colorLutDim, _colorLutFile.empty() ? "" : " from ", _colorLutFile.c_str());
+            if (_colorLutDirty)
+                invalidateStages("pro_color");
+        }
+
+        if (ImGui::CollapsingHeader("Calibration", nullptr, ImGuiTreeNodeFlags_DefaultOpen)) {
+            if (ImGui::Checkbox("Use calibrated profile", &_camera.useCalibration))
+                invalidateStages("pro_lens_shading");
+            if (ImGui::Button("Calibrate"))
+                _shouldCalibrate = true;
+            ImGui::SameLine();
+            ImGui::Text("Last calibration: %.0f ms", _calibrationTime);
+
+            const CalibrationProfile& p = _camera.calibration;
+            ImGui::Text("Vignetting: %.3f %.3f %.3f %.3f %.3f", p.vignettingCoeffs[0], p.vignettingCoeffs[1], p.vignettingCoeffs[2],
+                        p.vignettingCoeffs[3], p.vignettingCoeffs[4]);
+            ImGui::Text("Color shading (corner): %.3f %.3f %.3f", p.colorShading.back().x, p.colorShading.back().y, p.colorShading.back().z);
+            ImGui::Text("Lens shading mesh: %ux%u, %s", LENS_SHADING_MESH_W, LENS_SHADING_MESH_H,
+                        p.lensShading.empty() ? "derived from the radial profile" : "measured");
+            ImGui::Text("Chromatic aberration R: %.4f %.4f", p.chromaticAberrationCoeffsR[0], p.chromaticAberrationCoeffsR[1]);
+            ImGui::Text("Chromatic aberration B: %.4f %.4f", p.chromaticAberrationCoeffsB[0], p.chromaticAberrationCoeffsB[1]);
+        }
+
+        if (ImGui::CollapsingHeader("Equivalence harness")) {
+            if (ImGui::Button("Verify"))
+                _shouldVerify = true;
+            ImGui::SameLine();
+            if (ImGui::Button("Update golden checksums"))
+                _shouldVerify = _updateGoldenChecksums = true;
+            size_t passed = std::count_if(_equivalenceResults.begin(), _equivalenceResults.end(), [](const auto& r) { return r.passed; });
+            ImGui::Text("Last run: %.0f ms, %zu/%zu stage checks passed, %u golden checksum mismatches", _verifyTime, passed,
+                        _equivalenceResults.size(), _goldenMismatches);
+
+            if (!_equivalenceResults.empty() && ImGui::BeginTable("Equivalence", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Variant");
+                ImGui::TableSetupColumn("Stage");
+                ImGui::TableSetupColumn("Max diff");
+                ImGui::TableSetupColumn("Mean diff");
+                ImGui::TableSetupColumn("Worst input");
+                ImGui::TableSetupColumn("Result");
+                ImGui::TableHeadersRow();
+                for (const EquivalenceResult& result : _equivalenceResults) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", result.variant.c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", result.stage.c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%u", result.maxDiff);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.4f", result.meanDiff);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", result.input.c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", result.passed ? "pass" : "FAIL");
+                }
+                ImGui::EndTable();
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Out-of-core processing")) {
+            static char inputPath[256] = "";
+            static char outputPath[256] = "";
+            ImGui::InputText("Input (.ppm)", inputPath, sizeof(inputPath));
+            ImGui::InputText("Output (.ppm)", outputPath, sizeof(outputPath));
+            ImGui::SliderInt("Tile size", &_outOfCoreTileSize, 128, 2048);
+            if (ImGui::Button("Process##OOC")) {
+                _outOfCoreInput = inputPath;
+                _outOfCoreOutput = outputPath;
+                _shouldProcessOutOfCore = true;
+            }
+            ImGui::SameLine();
+            ImGui::Text("Last run: %.0f ms, tile buffers: %.1f MB per thread", _outOfCoreTime, _outOfCoreBufferSize / 1e6f);
+        }
+
+        if (ImGui::CollapsingHeader("Batch processing")) {
+            static char inputDir[256] = "";
+            static char outputDir[256] = "";
+            ImGui::InputText("Input directory", inputDir, sizeof(inputDir));
+            ImGui::InputText("Output directory", outputDir, sizeof(outputDir));
+            auto stageGetter = [](void* userData, int idx) -> const char* {
+                const auto* stages = static_cast<const std::vector<Stage>*>(userData);
+                return idx >= 0 && idx < int(stages->size()) ? stages->at(idx).name.c_str() : nullptr;
+            };
+            auto isOutput = [&](const Stage& s) { return s.name == _batchOutputStage; };
+            int stage = int(std::find_if(_stages.begin(), _stages.end(), isOutput) - _stages.begin());
+            if (ImGui::Combo("Output stage", &stage, stageGetter, static_cast<void*>(&_stages), _stages.size()))
+                _batchOutputStage = _stages[stage].name;
+            ImGui::SliderInt("Workers (0 = all cores)", &_batchWorkers, 0, int(std::thread::hardware_concurrency()));
+            if (ImGui::Button("Process##Batch")) {
+                _batchInput = inputDir;
+                _batchOutput = outputDir;
+                _shouldProcessBatch = true;
+            }
+            ImGui::SameLine();
+            ImGui::Text("Last run: %zu images in %.0f ms (%.1f images/s, %zu steals)", _batchImages, _batchTime,
+                        _batchTime > 0.0f ? _batchImages * 1000.0f / _batchTime : 0.0f, _batchSteals);
+        }
+        if (ImGui::CollapsingHeader("Multi-stream processing")) {
+            static char streams[2048] = "";
+            static char outputDir[256] = "";
+            ImGui::InputTextMultiline("Streams (file[, calibration profile] per line)", streams, sizeof(streams));
+            ImGui::InputText("Output directory##Streams", outputDir, sizeof(outputDir));
+            auto stageGetter = [](void* userData, int idx) -> const char* {
+                const auto* stages = static_cast<const std::vector<Stage>*>(userData);
+                return idx >= 0 && idx < int(stages->size()) ? stages->at(idx).name.c_str() : nullptr;
+            };
+            auto isOutput = [&](const Stage& s) { return s.name == _streamOutputStage; };
+            int stage = int(std::find_if(_stages.begin(), _stages.end(), isOutput) - _stages.begin());
+            if (ImGui::Combo("Output stage##Streams", &stage, stageGetter, static_cast<void*>(&_stages), _stages.size()))
+                _streamOutputStage = _stages[stage].name;
+            ImGui::SliderInt("Workers (0 = all cores)##Streams", &_streamWorkers, 0, int(std::thread::hardware_concurrency()));
+            if (ImGui::Button("Process##Streams")) {
+                _streamInputs.clear();
+                std::istringstream lines(streams);
+                for (std::string line; std::getline(lines, line);)
+                    _streamInputs.push_back(line);
+                _streamOutput = outputDir;
+                _shouldProcessStreams = true;
+            }
+            ImGui::SameLine();
+            ImGui::Text("Last run: %.0f ms", _streamTime);
+            if (!_streamResults.empty() && ImGui::BeginTable("Streams", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Stream");
+                ImGui::TableSetupColumn("Frames");
+                ImGui::TableSetupColumn("Frame time (ms)");
+                ImGui::TableSetupColumn("Result");
+                ImGui::TableHeadersRow();
+                for (const StreamResult& result : _streamResults) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", result.input.c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%zu", result.frames);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.1f", result.frames > 0 ? result.time / result.frames : 0.0f);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", result.failed ? "failed" : "ok");
+                }
+                ImGui::EndTable();
+            }
+        }
+    }
+    ImGui::End();
+
+    ImGui::SetNextWindowSize({600, 500}, ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Image quality")) {
+        ImGui::Checkbox("Compute metrics", &_computeMetrics);
+        ImGui::Text("Pipeline: %.1f ms, metrics: %.1f ms", _pipelineTime, _metricsTime);
+        if (!_stageMetrics.empty() && stageStale(_stageMetrics.back().first))
+            ImGui::Text("Metrics of the changed stages are stale (visible region evaluation), zoom out to update them");
+        if (ImGui::BeginTable("Metrics", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Stage");
+            ImGui::TableSetupColumn("PSNR R (dB)");
+            ImGui::TableSetupColumn("PSNR G (dB)");
+            ImGui::TableSetupColumn("PSNR B (dB)");
+            ImGui::TableSetupColumn("SSIM");
+            ImGui::TableSetupColumn("Mean ΔE00");
+            ImGui::TableHeadersRow();
+            for (const auto& [name, metrics] : _stageMetrics) {
+                if (stageStale(name))
+                    continue;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", name.c_str());
+                for (int c = 0; c < 3; c++) {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", metrics.psnr[c]);
+                }
+                ImGui::TableNextColumn();
+                ImGui::Text("%.4f", metrics.ssim);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", metrics.deltaE);
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+
+    ImGui::SetNextWindowSize({500, 600}, ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Memory")) {
+        size_t held = 0;
+        for (const MemoryEntry& entry : _memoryFootprint)
+            held += entry.bytes;
+        AllocationCount total;
+        for (const auto& [name, allocations] : _stageAllocations) {
+            total.count += allocations.count;
+            total.bytes += allocations.bytes;
+        }
+        ImGui::Checkbox("Log after each reprocess", &_logMemory);
+        ImGui::SameLine();
+        if (ImGui::Button("Log report"))
+            logMemoryReport();
+        ImGui::Text("Held: %.2f MB, peak resident: %.1f MB (%s)", held / 1e6, _peakResidentMemory / 1e6,
+                    _peakResidentMemoryReset ? "last reprocess" : "since startup");
+        ImGui::Text("Last reprocess: %llu allocations (%.2f MB)", (unsigned long long)total.count, total.bytes / 1e6);
+        if (ImGui::BeginTable("Allocations", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Stage");
+            ImGui::TableSetupColumn("Allocations");
+            ImGui::TableSetupColumn("Allocated (KB)");
+            ImGui::TableHeadersRow();
+            for (const auto& [name, allocations] : _stageAllocations) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", (unsigned long long)allocations.count);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", allocations.bytes / 1e3);
+            }
+            ImGui::EndTable();
+        }
+        if (ImGui::BeginTable("Footprint", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Held by");
+            ImGui::TableSetupColumn("Kind");
+            ImGui::TableSetupColumn("Size (KB)");
+            ImGui::TableHeadersRow();
+            for (const MemoryEntry& entry : _memoryFootprint) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", entry.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", entry.kind.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", entry.bytes / 1e3);
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+
     ImGui::SetNextWindowSize({1000, 750}, ImGuiCond_FirstUseEver);
     if (ImGui::Begin("Image Pipeline")) {
         // Combo to select test image
@@ -145,83 +792,138 @@ void Project::onUIRender() {
                 return nullptr;
             return vec->at(idx).c_str();
         };
-        // if (ImGui::Combo("Test Image", &_selectedImage, imgGetter, static_cast<void*>(&_testImages), _testImages.size()))
-        //     _shouldReprocess = true;
+        if (ImGui::Combo("Test Image", &_selectedImage, imgGetter, static_cast<void*>(&_testImages), _testImages.size()) &&
+            openInput(fil::getProject()->getResourceRootPaths()[0] / _testImages[_selectedImage]))
+            invalidateStages();
+
+        if (ImGui::CollapsingHeader("Input")) {
+            static char inputPath[256] = "";
+            ImGui::InputText("Path (file, FIFO or - for stdin)", inputPath, sizeof(inputPath));
+            ImGui::SameLine();
+            if (ImGui::Button("Open##Input") && openInput(inputPath))
+                invalidateStages();
+
+            // Raw files and streams have no header
+            const char* formats[] = {"RGB", "Gray", "Bayer RGGB", "YUV 4:2:0", "YUV 4:4:4", "YUV 4:0:0"};
+            int format = int(_rawLayout.format);
+            if (ImGui::Combo("Raw format", &format, formats, 6))
+                _rawLayout.format = PixelFormat(format);
+            int rawWidth = int(_rawLayout.width);
+            int rawHeight = int(_rawLayout.height);
+            if (ImGui::InputInt("Raw width", &rawWidth))
+                _rawLayout.width = uint32_t(std::max(rawWidth, 1));
+            if (ImGui::InputInt("Raw height", &rawHeight))
+                _rawLayout.height = uint32_t(std::max(rawHeight, 1));
+
+            if (_inputFrames.size() > 1) {
+                if (ImGui::SliderInt("Frame", &_inputFrame, 0, int(_inputFrames.size()) - 1) && readInputFrame())
+                    invalidateStages();
+                ImGui::Checkbox("Play", &_inputPlay);
+            }
+            const char* containers[] = {"none", "image", "PNM", "Y4M", "raw"};
+            ImGui::Text("Input: %s%s %ux%u %s, last frame read in %.2f ms", containers[int(_inputContainer)], _inputFd >= 0 ? " stream" : "",
+                        _inputLayout.width, _inputLayout.height, formats[int(_inputLayout.format)], _inputTime);
+        }
+
+        // Zoomed-in stages are only processed in the visible region
+        ImGui::Checkbox("Evaluate visible region only", &_roiEvaluation);
+        if (_roiPartial)
+            ImGui::Text("Region %ux%u at (%u, %u) of %s processed in %.2f ms%s", _roiRegion.w, _roiRegion.h, _roiRegion.x, _roiRegion.y,
+                        _stages[_roiStage].name.c_str(), _pipelineTime, stageStale(_stages.back().name) ? ", stale thumbnails and metrics" : "");
 
         // Compute image ratio
         res::Image* refImgRes = res::get<res::Image>("reference");
         float ratio = float(refImgRes->getHeight()) / float(refImgRes->getWidth());
 
-        // Get ImGui images
-        ImTextureID refImg = (ImTextureID)gfx::getImGuiImage("reference");
-        ImTextureID degWhiteBalanceImg = (ImTextureID)gfx::getImGuiImage("deg_white_balance");
-        ImTextureID degLensImg = (ImTextureID)gfx::getImGuiImage("deg_lens");
-        ImTextureID degColorShadingImg = (ImTextureID)gfx::getImGuiImage("deg_color_shading");
-        ImTextureID degChromaticAberrationImg = (ImTextureID)gfx::getImGuiImage("deg_chromatic_aberration");
-        ImTextureID degVignettingImg = (ImTextureID)gfx::getImGuiImage("deg_vignetting");
-        ImTextureID degBlackLevelImg = (ImTextureID)gfx::getImGuiImage("deg_black_level");
-        ImTextureID degDeadPixelImg = (ImTextureID)gfx::getImGuiImage("deg_dead_pixel");
-        ImTextureID degOutputImg = (ImTextureID)gfx::getImGuiImage("deg_output");
-
-        ImTextureID proDeadPixelImg = (ImTextureID)gfx::getImGuiImage("pro_dead_pixel");
-        ImTextureID proBlackLevelImg = (ImTextureID)gfx::getImGuiImage("pro_black_level");
-        ImTextureID proVignettingImg = (ImTextureID)gfx::getImGuiImage("pro_vignetting");
-        ImTextureID proChromaticAberrationImg = (ImTextureID)gfx::getImGuiImage("pro_chromatic_aberration");
-        ImTextureID proColorShadingImg = (ImTextureID)gfx::getImGuiImage("pro_color_shading");
-        ImTextureID proLensImg = (ImTextureID)gfx::getImGuiImage("pro_lens");
-        ImTextureID proWhiteBalanceImg = (ImTextureID)gfx::getImGuiImage("pro_white_balance");
-        ImTextureID proOutputImg = (ImTextureID)gfx::getImGuiImage("pro_output");
-
         // Plot image degradation stages
         const ImPlotAxisFlags axisFlags = ImPlotAxisFlags_NoTickLabels;
         if (ImPlot::BeginPlot("Image pipeline", {-1, -1}, ImPlotFlags_Equal)) {
             ImPlot::SetupAxes(nullptr, nullptr, axisFlags, axisFlags);
+            _plotRects.clear();
             float x = 0.0f;
             float y = 0.0f;
 
-            plotImage("Reference image", refImg, x, y, 1.0f, ratio);
+            plotStage("Reference image", "reference", x, y, 1.0f, ratio);
             x += 1.05f;
-            plotImage("Degraded image", degOutputImg, x, y, 1.0f, ratio);
+            plotStage("Degraded image", "deg_output", x, y, 1.0f, ratio);
             x += 1.05f;
-            plotImage("Processed image", proOutputImg, x, y, 1.0f, ratio);
+            plotStage("Processed image", "pro_output", x, y, 1.0f, ratio);
 
             // Plot degradation stages
             y -= 1.5f;
             x = 0.0f;
 
-            plotImage("White balance error", degWhiteBalanceImg, x, y, 1.0f, ratio);
+            plotStage("White balance error", "deg_white_balance", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Lens distortion", degLensImg, x, y, 1.0f, ratio);
+            plotStage("Lens distortion", "deg_lens", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Color shading error", degColorShadingImg, x, y, 1.0f, ratio);
+            plotStage("Color shading error", "deg_color_shading", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Chromatic aberration", degChromaticAberrationImg, x, y, 1.0f, ratio);
+            plotStage("Chromatic aberration", "deg_chromatic_aberration", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Vignetting", degVignettingImg, x, y, 1.0f, ratio);
+            plotStage("Vignetting", "deg_vignetting", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Black level offset", degBlackLevelImg, x, y, 1.0f, ratio);
+            plotStage("Sensor noise", "deg_sensor_noise", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Dead pixel injection", degDeadPixelImg, x, y, 1.0f, ratio);
+            plotStage("Black level offset", "deg_black_level", x, y, 1.0f, ratio);
+            x += 1.1f;
+            plotStage("Dead pixel injection", "deg_dead_pixel", x, y, 1.0f, ratio);
 
             // Plot image processing stages
             y -= 1.5f;
             x = 0.0f;
 
-            plotImage("Dead pixel correction", proDeadPixelImg, x, y, 1.0f, ratio);
+            plotStage("Dead pixel correction", "pro_dead_pixel", x, y, 1.0f, ratio);
+            x += 1.1f;
+            plotStage("Black level correction", "pro_black_level", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Black level correction", proBlackLevelImg, x, y, 1.0f, ratio);
+            plotStage("Noise reduction", "pro_noise_reduction", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Vignetting correction", proVignettingImg, x, y, 1.0f, ratio);
+            plotStage("Lens shading correction", "pro_lens_shading", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Chromatic aberration correction", proChromaticAberrationImg, x, y, 1.0f, ratio);
+            plotStage("Chromatic aberration correction", "pro_chromatic_aberration", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Color shading correction", proColorShadingImg, x, y, 1.0f, ratio);
+            plotStage("Lens correction", "pro_lens", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("Lens correction", proLensImg, x, y, 1.0f, ratio);
+            plotStage("White balance correction", "pro_white_balance", x, y, 1.0f, ratio);
             x += 1.1f;
-            plotImage("White balance correction", proWhiteBalanceImg, x, y, 1.0f, ratio);
+            plotStage("Color correction", "pro_color", x, y, 1.0f, ratio);
             x += 1.1f;
 
+            // Select the stage to display at full resolution. This is only needed when the thumbnail is magnified on screen, in which case the
+            // stage under the cursor (or at the center of the view) is selected
+            ImPlotRect limits = ImPlot::GetPlotLimits();
+            float imageScreenWidth = ImPlot::GetPlotSize().x / float(limits.X.Size());
+            uint32_t thumbWidth = res::get<res::Image>("reference_thumb")->getWidth();
+            _focusedStage.clear();
+            if (imageScreenWidth > thumbWidth) {
+                ImPlotPoint p(limits.X.Min + limits.X.Size() / 2.0, limits.Y.Min + limits.Y.Size() / 2.0);
+                if (ImPlot::IsPlotHovered())
+                    p = ImPlot::GetPlotMousePos();
+                for (const PlotRect& rect : _plotRects)
+                    if (p.x >= rect.x && p.x <= rect.x + rect.w && p.y >= rect.y && p.y <= rect.y + rect.h)
+                        _focusedStage = rect.name;
+            }
+
+            // Visible region of the focused stage in frame pixels (image row 0 is at the top of its plot rectangle)
+            _viewRegion = Region{};
+            for (const PlotRect& rect : _plotRects) {
+                if (rect.name != _focusedStage)
+                    continue;
+                const uint32_t imgW = refImgRes->getWidth();
+                const uint32_t imgH = refImgRes->getHeight();
+                auto toPixel = [](double t, uint32_t size, bool end) {
+                    t = std::clamp(t, 0.0, 1.0) * size;
+                    return uint32_t(end ? std::ceil(t) : std::floor(t));
+                };
+                uint32_t x0 = toPixel((limits.X.Min - rect.x) / rect.w, imgW, false);
+                uint32_t x1 = toPixel((limits.X.Max - rect.x) / rect.w, imgW, true);
+                uint32_t y0 = toPixel((rect.y + rect.h - limits.Y.Max) / rect.h, imgH, false);
+                uint32_t y1 = toPixel((rect.y + rect.h - limits.Y.Min) / rect.h, imgH, true);
+                if (x1 > x0 && y1 > y0)
+                    _viewRegion = Region{x0, y0, x1 - x0, y1 - y0};
+            }
+
             ImPlot::EndPlot();
         }
     }
@@ -229,535 +931,1091 @@ void Project::onUIRender() {
 }
 
 void Project::onAttaLoop() {
-    if (_shouldReprocess) {
-        res::Image* refImg = res::get<res::Image>("reference");
-        uint8_t* refData = refImg->getData();
-        uint32_t w = refImg->getWidth();
-        uint32_t h = refImg->getHeight();
-        atta::vec2 center(w / 2.0f, h / 2.0f);
-        uint32_t ch = refImg->getChannels();
-
-        // Load test image
-        // fs::path testImgPath = fs::absolute("resources/" + _testImages[_selectedImage]);
-        // LOG_INFO("Project", "Processing test image [w]$0[]...", testImgPath);
-        // refImg->load(testImgPath);
-        // Resize images
-        // blackLevelImg->resize(refImg->getWidth(), refImg->getHeight());
-        // outputImg->resize(refImg->getWidth(), refImg->getHeight());
-
-        //---------- Image degradation pipeline ----------//
-        // White balance error
-        res::Image* whiteBalanceImg = res::get<res::Image>("deg_white_balance");
-        uint8_t* whiteBalanceData = whiteBalanceImg->getData();
-        degWhiteBalanceError(refData, whiteBalanceData, w, h, ch);
-        whiteBalanceImg->update();
-
-        // Barrel lens distortion
-        res::Image* lensImg = res::get<res::Image>("deg_lens");
-        uint8_t* lensData = lensImg->getData();
-        degLensDistortion(whiteBalanceData, lensData, w, h, ch);
-        lensImg->update();
-
-        // Color shading error
-        res::Image* colorShadingImg = res::get<res::Image>("deg_color_shading");
-        uint8_t* colorShadingData = colorShadingImg->getData();
-        degColorShadingError(lensData, colorShadingData, w, h, ch);
-        colorShadingImg->update();
-
-        // Chromatic aberration
-        res::Image* chromaticAberrationImg = res::get<res::Image>("deg_chromatic_aberration");
-        uint8_t* chromaticAberrationData = chromaticAberrationImg->getData();
-        degChromaticAberrationError(colorShadingData, chromaticAberrationData, w, h, ch);
-        chromaticAberrationImg->update();
-
-        // Vignetting error
-        res::Image* vignettingImg = res::get<res::Image>("deg_vignetting");
-        uint8_t* vignettingData = vignettingImg->getData();
-        degVignettingError(chromaticAberrationData, vignettingData, w, h, ch);
-        vignettingImg->update();
-
-        // Black level offset
-        res::Image* blackLevelImg = res::get<res::Image>("deg_black_level");
-        uint8_t* blackLevelData = blackLevelImg->getData();
-        degBlackLevelOffset(vignettingData, blackLevelData, w, h, ch);
-        blackLevelImg->update();
-
-        // Dead pixel injection
-        res::Image* deadPixelImg = res::get<res::Image>("deg_dead_pixel");
-        uint8_t* deadPixelData = deadPixelImg->getData();
-        degDeadPixelInjection(blackLevelData, deadPixelData, w, h, ch);
-        deadPixelImg->update();
-
-        // Degradation output image
-        res::Image* outputImg = res::get<res::Image>("deg_output");
-        uint8_t* outputData = outputImg->getData();
-        for (uint32_t i = 0; i < w * h * ch; i++)
-            outputData[i] = deadPixelData[i];
-        outputImg->update();
-
-        //---------- Image processing pipeline ----------//
-        // Dead pixel correction
-        res::Image* proDeadPixelImg = res::get<res::Image>("pro_dead_pixel");
-        uint8_t* proDeadPixelData = proDeadPixelImg->getData();
-        proDeadPixelCorrection(outputData, proDeadPixelData, w, h, ch);
-        proDeadPixelImg->update();
-
-        // Black level correction
-        res::Image* proBlackLevelImg = res::get<res::Image>("pro_black_level");
-        uint8_t* proBlackLevelData = proBlackLevelImg->getData();
-        proBlackLevelCorrection(proDeadPixelData, proBlackLevelData, w, h, ch);
-        proBlackLevelImg->update();
-
-        // Vignetting correction
-        res::Image* proVignettingImg = res::get<res::Image>("pro_vignetting");
-        uint8_t* proVignettingData = proVignettingImg->getData();
-        proVignettingCorrection(proBlackLevelData, proVignettingData, w, h, ch);
-        proVignettingImg->update();
-
-        // Chromatic aberration correction
-        res::Image* proChromaticAberrationImg = res::get<res::Image>("pro_chromatic_aberration");
-        uint8_t* proChromaticAberrationData = proChromaticAberrationImg->getData();
-        proChromaticAberrationCorrection(proVignettingData, proChromaticAberrationData, w, h, ch);
-        proChromaticAberrationImg->update();
-
-        // Color shading correction
-        res::Image* proColorShadingImg = res::get<res::Image>("pro_color_shading");
-        uint8_t* proColorShadingData = proColorShadingImg->getData();
-        proColorShadingCorrection(proChromaticAberrationData, proColorShadingData, w, h, ch);
-        proColorShadingImg->update();
-
-        // Lens correction
-        res::Image* proLensImg = res::get<res::Image>("pro_lens");
-        uint8_t* proLensData = proLensImg->getData();
-        proLensCorrection(proColorShadingData, proLensData, w, h, ch);
-        proLensImg->update();
-
-        // White balance correction
-        res::Image* proWhiteBalanceImg = res::get<res::Image>("pro_white_balance");
-        uint8_t* proWhiteBalanceData = proWhiteBalanceImg->getData();
-        proWhiteBalanceCorrection(proLensData, proWhiteBalanceData, w, h, ch); // Apply ideal white balance correction
-        // proWhiteBalanceCorrectionAuto(proLensData, proWhiteBalanceData, w, h, ch); // Apply automatic white balance correction
-        proWhiteBalanceImg->update();
-
-        // Processed output
-        res::Image* proOutputImg = res::get<res::Image>("pro_output");
-        uint8_t* proOutputData = proOutputImg->getData();
-        for (uint32_t i = 0; i < w * h * ch; i++)
-            proOutputData[i] = proWhiteBalanceData[i];
-        proOutputImg->update();
-
-        _shouldReprocess = false;
+    if (_shouldCalibrate) {
+        runCalibration();
+        _shouldCalibrate = false;
+        invalidateStages("pro_lens_shading");
     }
-}
-
-void Project::degWhiteBalanceError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    for (uint32_t i = 0; i < w * h; i++) {
-        // Get the RGB values for the current pixel
-        uint8_t r = inData[i * ch];
-        uint8_t g = inData[i * ch + 1];
-        uint8_t b = inData[i * ch + 2];
 
-        // Apply the temperature gain to each channel
-        const atta::vec3 gains = tempToGain(_colorTemperature);
-        outData[i * ch] = static_cast<uint8_t>(std::clamp(r * gains.x, 0.0f, 255.0f));
-        outData[i * ch + 1] = static_cast<uint8_t>(std::clamp(g * gains.y, 0.0f, 255.0f));
-        outData[i * ch + 2] = static_cast<uint8_t>(std::clamp(b * gains.z, 0.0f, 255.0f));
+    if (_shouldVerify) {
+        runEquivalenceHarness();
+        _shouldVerify = false;
+        _updateGoldenChecksums = false;
+        _shouldReprocess = true; // Stage state was generated for the harness inputs
     }
-}
-
-void Project::degLensDistortion(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    atta::vec2 center(w / 2.0f, h / 2.0f);
-    for (uint32_t y = 0; y < h; y++) {
-        for (uint32_t x = 0; x < w; x++) {
-            uint32_t idx = (y * w + x) * ch;
-
-            // Compute normalized radial distance
-            atta::vec2 delta = atta::vec2(x, y) - center;
-            float r = delta.length() / center.length();
-            float r2 = r * r;
-            float r4 = r2 * r2;
-
-            // Compute barrel distortion polynomial (source radius)
-            float lensR = r * (_barrelDistortionCoeffs[0] + _barrelDistortionCoeffs[1] * r2 + _barrelDistortionCoeffs[2] * r4);
 
-            // Compute angle
-            float angle = 0.0f;
-            if (delta.squareLength() > 1e-5f)
-                angle = std::atan2(delta.y, delta.x); // Avoid division by zero at the exact center
-
-            // Compute source pixel coordinates
-            float xDist = center.x + lensR * std::cos(angle) * center.length();
-            float yDist = center.y + lensR * std::sin(angle) * center.length();
+    if (_shouldProcessOutOfCore) {
+        processOutOfCore(_outOfCoreInput, _outOfCoreOutput);
+        _shouldProcessOutOfCore = false;
+        _shouldReprocess = true; // Stage state was generated for the out-of-core image
+    }
 
-            // Sample distorted coordinate in source image
-            atta::vec3 pixel = bilinearSampling(inData, w, h, ch, xDist, yDist);
-            outData[idx + 0] = static_cast<uint8_t>(pixel.x);
-            outData[idx + 1] = static_cast<uint8_t>(pixel.y);
-            outData[idx + 2] = static_cast<uint8_t>(pixel.z);
-        }
+    if (_shouldProcessBatch) {
+        processBatch(_batchInput, _batchOutput);
+        _shouldProcessBatch = false;
+        _shouldReprocess = true; // Stage state was generated for the batch images
     }
-}
 
-void Project::degColorShadingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    atta::vec2 center(w / 2.0f, h / 2.0f);
-    for (uint32_t y = 0; y < h; y++) {
-        for (uint32_t x = 0; x < w; x++) {
-            uint32_t idx = (y * w + x) * ch;
+    if (_shouldProcessStreams) {
+        processStreams(_streamInputs, _streamOutput);
+        _shouldProcessStreams = false;
+        _shouldReprocess = true; // Stage state was generated for the streams
+    }
 
-            // Compute normalized radial distance
-            float r = (atta::vec2(x, y) - center).length() / center.length();
+    // New frame from the input stream, or next frame of a multi-frame file
+    if (_inputPlay && !_inputFrames.empty())
+        _inputFrame = (_inputFrame + 1) % int(_inputFrames.size());
+    if ((_inputFd >= 0 || _inputPlay) && readInputFrame())
+        invalidateStages();
+
+    // While a stage is inspected at full resolution, only its visible region is processed. The stage images are then only partially up to
+    // date, so the region is processed again when the view leaves it, and the whole frame when no stage is inspected anymore
+    size_t viewStage = _stages.size();
+    for (size_t s = 0; s < _stages.size(); s++)
+        if (_stages[s].name == _focusedStage)
+            viewStage = s;
+    const bool roiView = _roiEvaluation && viewStage < _stages.size() && _viewRegion.w > 0;
+    if (roiView && (_shouldReprocess || (_roiPartial && (viewStage != _roiStage || !_roiRegion.contains(_viewRegion))))) {
+        res::Image* refImg = res::get<res::Image>("reference");
+        processRegion(viewStage, growRegion(_viewRegion, ROI_MARGIN, refImg->getWidth(), refImg->getHeight()));
+        _shouldReprocess = false;
+    } else if (_roiPartial && !roiView)
+        _shouldReprocess = true; // The changes since the last whole frame reprocess are still pending (_firstDirtyStage, _referenceDirty)
 
-            // Compute color shading indices
-            uint32_t gainIdx1 = static_cast<uint32_t>(r * (COLOR_SHADING_COUNT - 1));
-            uint32_t gainIdx2 = gainIdx1 + 1;
-            if (gainIdx2 >= COLOR_SHADING_COUNT)
-                gainIdx2 = COLOR_SHADING_COUNT - 1;
+    if (_shouldReprocess) {
+        auto pipelineStart = std::chrono::steady_clock::now();
+        res::Image* refImg = res::get<res::Image>("reference");
+        uint32_t w = refImg->getWidth();
+        uint32_t h = refImg->getHeight();
+        uint32_t ch = refImg->getChannels();
 
-            // Interpolate gain
-            float t = r * (COLOR_SHADING_COUNT - 1) - static_cast<float>(gainIdx1);
-            const atta::vec3& gain1 = _colorShadingError[gainIdx1];
-            const atta::vec3& gain2 = _colorShadingError[gainIdx2];
-            atta::vec3 gain = (1.0f - t) * gain1 + t * gain2;
+        if (_referenceDirty)
+            updateStageDisplay("reference");
+
+        // Run the image degradation pipeline followed by the image processing pipeline on the whole frame. Frames with a different layout or
+        // number of channels than the images are converted once from the reference, and each stage output is converted into its image for
+        // display
+        const uint32_t frameCh = _frameChannels;
+        const bool convert = _planarLayout || frameCh != ch;
+        _peakResidentMemoryReset = resetPeakResidentMemory();
+        _stageAllocations.clear();
+        AllocationCount allocations = allocationCount();
+        prepareStages(w, h, frameCh);
+        const Tile frame = fullFrame(w, h, _planarLayout);
+        const uint8_t* inData = refImg->getData();
+        if (convert) {
+            for (TrackedVector<uint8_t>& buffer : _stageFrames)
+                buffer.resize(size_t(w) * h * frameCh);
+            imageToFrame(refImg->getData(), ch, _stageFrames[0].data(), frameCh, size_t(w) * h, _planarLayout);
+            inData = _stageFrames[0].data();
+        }
+        _stageAllocations.push_back({"prepare", allocationCount() - allocations});
+        size_t scalerIndex = _stages.size(); // Stages after the scaler run on the scaled outputs too
+        for (size_t s = 0; s < _stages.size(); s++) {
+            const Stage& stage = _stages[s];
+            allocations = allocationCount();
+            res::Image* stageImg = res::get<res::Image>(stage.name);
+            uint8_t* outData = convert ? _stageFrames[inData == _stageFrames[0].data() ? 1 : 0].data() : stageImg->getData();
+            auto start = std::chrono::steady_clock::now();
+            (this->*stage.func)(inData, outData, w, h, frameCh, frame);
+            if (stage.func == &Project::proNoiseReduction)
+                _noiseReductionTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (convert)
+                frameToImage(outData, frameCh, _planarLayout, stageImg->getData(), ch, size_t(w) * h);
+            _stageAllocations.push_back({stage.name, allocationCount() - allocations});
+            if (_scalerEnabled && stage.name == _scalerStage) {
+                allocations = allocationCount();
+                start = std::chrono::steady_clock::now();
+                runScaler(outData, w, h, frameCh, _planarLayout);
+                _scalerTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+                _stageAllocations.push_back({"scaler", allocationCount() - allocations});
+                scalerIndex = s;
+            }
+            if (s < scalerIndex && s >= _firstDirtyStage)
+                updateStageDisplay(stage.name);
+            inData = outData;
+        }
 
-            const uint8_t* inPix = &inData[idx];
-            atta::vec3 pixel(inPix[0], inPix[1], inPix[2]);
-            atta::vec3 shadedPixel = pixel * gain;
+        // Scaled outputs, which also give the thumbnails of the scaler stage and the following stages
+        if (scalerIndex < _stages.size()) {
+            allocations = allocationCount();
+            auto start = std::chrono::steady_clock::now();
+            processScalerOutputs(scalerIndex + 1, frameCh, _planarLayout);
+            _scalerTime += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            _stageAllocations.push_back({"scaled_outputs", allocationCount() - allocations});
+            for (size_t s = std::max(scalerIndex, _firstDirtyStage); s < _stages.size(); s++)
+                updateStageDisplay(_stages[s].name, true);
+        }
+        _pipelineTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - pipelineStart).count();
 
-            // Save shaded pixel
-            outData[idx] = static_cast<uint8_t>(std::clamp(shadedPixel.x, 0.0f, 255.0f));
-            outData[idx + 1] = static_cast<uint8_t>(std::clamp(shadedPixel.y, 0.0f, 255.0f));
-            outData[idx + 2] = static_cast<uint8_t>(std::clamp(shadedPixel.z, 0.0f, 255.0f));
+        // Image quality metrics
+        if (_computeMetrics) {
+            allocations = allocationCount();
+            updateMetrics();
+            _stageAllocations.push_back({"metrics", allocationCount() - allocations});
         }
-    }
-}
 
-void Project::degChromaticAberrationError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    atta::vec2 center(w / 2.0f, h / 2.0f);
-    for (uint32_t y = 0; y < h; y++) {
-        for (uint32_t x = 0; x < w; x++) {
-            uint32_t idx = (y * w + x) * ch;
-            // Compute normalized radial distance
-            atta::vec2 delta = atta::vec2(x, y) - center;
-            float r = delta.length() / center.length();
-            float r2 = r * r;
-            float r3 = r2 * r;
+        // Memory held by the pipeline and peak resident memory of the reprocess
+        _memoryFootprint = memoryFootprint();
+        _peakResidentMemory = residentMemory(true);
+        if (_logMemory) {
+            size_t held = 0;
+            for (const MemoryEntry& entry : _memoryFootprint)
+                held += entry.bytes;
+            AllocationCount total;
+            for (const auto& [name, stageAllocations] : _stageAllocations) {
+                total.count += stageAllocations.count;
+                total.bytes += stageAllocations.bytes;
+            }
+            LOG_INFO("Memory", "Held $0 MB, peak resident $1 MB, $2 allocations ($3 MB)", held / 1e6, _peakResidentMemory / 1e6, total.count,
+                     total.bytes / 1e6);
+        }
 
-            // Calculate chromatic aberration displacement for Red channel
-            float displacementR = (_chromaticAberrationCoeffsR[0] * r2 + _chromaticAberrationCoeffsR[1] * r3);
-            float sxR_float = center.x + delta.x * (1.0f + displacementR);
-            float syR_float = center.y + delta.y * (1.0f + displacementR);
+        _shouldReprocess = false;
+        _firstDirtyStage = _stages.size();
+        _referenceDirty = false;
+        _roiPartial = false;
+    }
 
-            // Calculate chromatic aberration displacement for Blue channel
-            float displacementB = (_chromaticAberrationCoeffsB[0] * r2 + _chromaticAberrationCoeffsB[1] * r3);
-            float sxB_float = center.x + delta.x * (1.0f + displacementB);
-            float syB_float = center.y + delta.y * (1.0f + displacementB);
+    // Upload full resolution texture of the stage being inspected
+    uploadFocusedStage();
+}
 
-            // Sample from vignettingData (nearest neighbor sampling)
-            // outData[idx + 0] = (uint8_t)nearestNeighborSampling(inData, w, h, ch, sxR_float, syR_float).x;
-            // outData[idx + 1] = inData[(y * w + x) * ch + 1];
-            // outData[idx + 2] = (uint8_t)nearestNeighborSampling(inData, w, h, ch, sxB_float, syB_float).z;
+void Project::processRegion(size_t lastStage, const Region& region) {
+    auto start = std::chrono::steady_clock::now();
+    res::Image* refImg = res::get<res::Image>("reference");
+    uint32_t w = refImg->getWidth();
+    uint32_t h = refImg->getHeight();
+    uint32_t ch = refImg->getChannels();
+    const uint32_t frameCh = _frameChannels;
+    prepareStages(w, h, frameCh);
+
+    // Input region of each stage, from the region of the last stage back to the first stage
+    std::vector<Region> regions(lastStage + 2);
+    regions.back() = region;
+    for (size_t s = lastStage + 1; s-- > 0;) {
+        uint32_t halo = _stages[s].halo ? (this->*_stages[s].halo)(regions[s + 1], w, h) : 0;
+        regions[s] = growRegion(regions[s + 1], halo, w, h);
+    }
 
-            // Sample from vignettingData (bilinear sampling)
-            outData[idx + 0] = (uint8_t)bilinearSampling(inData, w, h, ch, sxR_float, syR_float).x;
-            outData[idx + 1] = inData[(y * w + x) * ch + 1];
-            outData[idx + 2] = (uint8_t)bilinearSampling(inData, w, h, ch, sxB_float, syB_float).z;
+    // Regions only shrink along the pipeline, so the buffers are sized by the first one. They also hold the region rows in the image layout
+    // when converting to and from the frame layout
+    TrackedVector<uint8_t>* a = &_stageFrames[0]; // Stage input
+    TrackedVector<uint8_t>* b = &_stageFrames[1]; // Stage output
+    const size_t bufferSize = size_t(regions[0].w) * regions[0].h * std::max(ch, frameCh);
+    if (a->size() < bufferSize) {
+        a->resize(bufferSize);
+        b->resize(bufferSize);
+    }
+    auto copyRows = [&](const Region& r, uint8_t* imageData, uint8_t* rows, bool toImage) {
+        for (uint32_t y = 0; y < r.h; y++) {
+            uint8_t* imageRow = imageData + (size_t(r.y + y) * w + r.x) * ch;
+            uint8_t* row = rows + size_t(y) * r.w * ch;
+            std::memcpy(toImage ? imageRow : row, toImage ? row : imageRow, size_t(r.w) * ch);
         }
+    };
+    copyRows(regions[0], refImg->getData(), b->data(), false);
+    imageToFrame(b->data(), ch, a->data(), frameCh, size_t(regions[0].w) * regions[0].h, _planarLayout);
+
+    // Each stage output is written to its image at the region position, and the full resolution texture is uploaded again when focused
+    for (size_t s = 0; s <= lastStage; s++) {
+        const Stage& stage = _stages[s];
+        const Region& out = regions[s + 1];
+        (this->*stage.func)(a->data(), b->data(), w, h, frameCh, Tile{regions[s], out, _planarLayout});
+        std::swap(a, b);
+        frameToImage(a->data(), frameCh, _planarLayout, b->data(), ch, size_t(out.w) * out.h);
+        copyRows(out, res::get<res::Image>(stage.name)->getData(), b->data(), true);
+        _stageDisplay[stage.name].fullUploaded = false;
     }
-}
 
-void Project::degVignettingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    atta::vec2 center(w / 2.0f, h / 2.0f);
-    for (uint32_t y = 0; y < h; y++) {
-        for (uint32_t x = 0; x < w; x++) {
-            uint32_t idx = (y * w + x) * ch;
+    _roiRegion = region;
+    _roiStage = lastStage;
+    _roiPartial = true;
+    _pipelineTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-            // Compute normalized radial distance
-            float r = (atta::vec2(x, y) - center).length() / center.length();
-            float r2 = r * r;
-            float r3 = r2 * r;
-            float r4 = r2 * r2;
+Project::Tile Project::fullFrame(uint32_t w, uint32_t h, bool planar) {
+    Region frame{0, 0, w, h};
+    return Tile{frame, frame, planar};
+}
 
-            // Compute vignetting polynomial
-            float vignetting =
-                _vignettingCoeffs[0] * r4 + _vignettingCoeffs[1] * r3 + _vignettingCoeffs[2] * r2 + _vignettingCoeffs[3] * r + _vignettingCoeffs[4];
+Project::Region Project::growRegion(const Region& region, uint32_t halo, uint32_t w, uint32_t h) {
+    halo = std::min(halo, std::max(w, h));
+    uint32_t x0 = region.x > halo ? region.x - halo : 0;
+    uint32_t y0 = region.y > halo ? region.y - halo : 0;
+    uint32_t x1 = std::min(w, region.x + region.w + halo);
+    uint32_t y1 = std::min(h, region.y + region.h + halo);
+    return Region{x0, y0, x1 - x0, y1 - y0};
+}
 
-            // Apply vignetting to the pixel
-            outData[idx] = static_cast<uint8_t>(std::clamp(inData[idx] * vignetting, 0.0f, 255.0f));
-            outData[idx + 1] = static_cast<uint8_t>(std::clamp(inData[idx + 1] * vignetting, 0.0f, 255.0f));
-            outData[idx + 2] = static_cast<uint8_t>(std::clamp(inData[idx + 2] * vignetting, 0.0f, 255.0f));
-        }
-    }
+void Project::prepareStages(uint32_t w, uint32_t h, uint32_t ch) {
+    prepareCamera(_camera, w, h, ch);
+    if (_colorLutDirty)
+        buildColorLut();
 }
 
-void Project::degBlackLevelOffset(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) {
-    // Apply black level offset
-    for (uint32_t i = 0; i < w * h * ch; i++) {
-        if (uint32_t(inData[i]) + _blackLevelOffset >= 255)
-            outData[i] = 255;
-        else
-            outData[i] = inData[i] + _blackLevelOffset;
-    }
+void Project::prepareCamera(CameraModule& camera, uint32_t w, uint32_t h, uint32_t ch) const {
+    generateObPixels(camera);
+    generateDeadPixels(camera, w, h, ch);
+    compileStagePlans(camera, w, h);
+}
 
+void Project::generateObPixels(CameraModule& camera) const {
     // Generate optical black pixel measurements
-    std::default_random_engine gen(42);
-    std::normal_distribution<float> dist(0.0f, 5.0f); // Gaussian distribution with mean 0 and stddev 5.0
-    for (size_t i = 0; i < _obPixels.size(); i++) {
+    const uint32_t key = randomHash(42, 0);
+    for (size_t i = 0; i < camera.obPixels.size(); i++) {
         // Generate perfect measurement
         atta::vec3 obPixel(_blackLevelOffset, _blackLevelOffset, _blackLevelOffset);
 
-        // Add Gaussian noise to each channel
-        for (uint32_t c = 0; c < ch; c++)
-            obPixel[c] = std::round(std::clamp(obPixel[c] + dist(gen), 0.0f, 255.0f));
+        // Add Gaussian noise to each channel (mean 0 and stddev 5.0)
+        for (uint32_t c = 0; c < 3; c++)
+            obPixel[c] = std::round(std::clamp(obPixel[c] + 5.0f * randomNormal(key, i * 3 + c), 0.0f, 255.0f));
 
-        _obPixels[i] = obPixel;
+        camera.obPixels[i] = obPixel;
     }
 }
 
-void Project::degDeadPixelInjection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) {
-    // Dead pixel injection (randomly set a channel to 0 - simulate photosite failure)
-    std::mt19937 gen(42);                           // Random number generator
-    std::uniform_real_distribution<> dis(0.0, 1.0); // Uniform distribution in [0, 1]
+void Project::generateDeadPixels(CameraModule& camera, uint32_t w, uint32_t h, uint32_t ch) const {
+    // Randomly select failed photosite channels (this list should be generated during calibration in practice). Each row has its own
+    // random key, so the list does not depend on the thread split and the counter does not overflow for large frames. The counter only
+    // enumerates the color values (alpha is not a sensor value), so RGB and RGBA frames get the same failed photosites
+    const uint32_t key = randomHash(42, 1);
+    const uint32_t threshold = uint32_t(std::clamp(double(_percentDeadPixels), 0.0, 1.0) * 4294967295.0);
+    const uint32_t colors = colorChannels(ch);
+    const uint32_t rowSize = w * ch;
+
+    // The list only changes with the frame size and the percentage, so it is not regenerated for every reprocess
+    const auto listKey = std::make_tuple(w, h, ch, _percentDeadPixels);
+    if (listKey == camera.deadPixelsKey)
+        return;
+    camera.deadPixelsKey = listKey;
 
-    _deadPixels.clear();
-    for (uint32_t i = 0; i < w * h * ch; i++) {
-        bool isDeadPixel = dis(gen) < _percentDeadPixels;
-        if (isDeadPixel) {
-            outData[i] = 0;
-            _deadPixels.push_back(i); // This list should be generated during calibration in practice in practice
-        } else {
-            outData[i] = inData[i];
+    // Reserve the expected count plus a margin (4 standard deviations), so the lists rarely grow while being filled
+    const double probability = threshold / 4294967296.0;
+    auto expectedCount = [&](uint32_t rows) {
+        const double mean = probability * rows * w * colors;
+        return size_t(mean + 4.0 * std::sqrt(mean) + 16.0);
+    };
+    std::mutex mutex;
+    camera.deadPixels.clear();
+    camera.deadPixels.reserve(expectedCount(h));
+    parallelFor(h, [&](uint32_t yBegin, uint32_t yEnd) {
+        TrackedVector<uint64_t> deadPixels;
+        deadPixels.reserve(expectedCount(yEnd - yBegin));
+        for (uint32_t y = yBegin; y < yEnd; y++) {
+            const uint32_t rowKey = randomHash(key, y);
+            for (uint32_t i = 0; i < w * colors; i++)
+                if (randomHash(rowKey, i) < threshold)
+                    deadPixels.push_back(uint64_t(y) * rowSize + i / colors * ch + i % colors);
         }
-    }
+        std::lock_guard<std::mutex> lock(mutex);
+        camera.deadPixels.insert(camera.deadPixels.end(), deadPixels.begin(), deadPixels.end());
+    });
+    std::sort(camera.deadPixels.begin(), camera.deadPixels.end());
 }
 
-void Project::proDeadPixelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    // Copy input data to output data
-    for (uint32_t i = 0; i < w * h * ch; i++)
-        outData[i] = inData[i];
-
-    // Dead pixel correction (nearest neighbor sampling)
-    for (uint32_t i = 0; i < _deadPixels.size(); i++) {
-        uint32_t idx = _deadPixels[i];
-        uint32_t sum = 0;
-        uint32_t count = 0;
+void Project::compileStagePlans(CameraModule& camera, uint32_t w, uint32_t h) const {
+    // White balance gains of the color temperature
+    const atta::vec3 gains = tempToGain(_colorTemperature);
 
-        // TODO should not use neighbor if the neighbor is also a dead pixel
-        if (idx >= ch) {
-            sum += inData[idx - ch];
-            count++;
-        }
-        if (idx + ch < w * h * ch) {
-            sum += inData[idx + ch];
-            count++;
-        }
-        if (idx >= ch * w) {
-            sum += inData[idx - ch * w];
-            count++;
-        }
-        if (idx + ch * w < w * h * ch) {
-            sum += inData[idx + ch * w];
-            count++;
-        }
-
-        // Average of 4 neighbors
-        outData[idx] = sum / count;
-    }
-}
-
-void Project::proBlackLevelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    // Copy input data to output data
-    for (uint32_t i = 0; i < w * h * ch; i++)
-        outData[i] = inData[i];
-
-    // Compute black level from optical black pixels
+    // Black level from the optical black pixels
     uint32_t blackLevelSum = 0;
-    for (size_t i = 0; i < _obPixels.size(); i++) {
+    for (size_t i = 0; i < camera.obPixels.size(); i++) {
         // Get the optical black pixel value
-        const atta::vec3& obPixel = _obPixels[i];
+        const atta::vec3& obPixel = camera.obPixels[i];
         // Sum channel values
         blackLevelSum += static_cast<uint32_t>(obPixel.x + obPixel.y + obPixel.z);
     }
-    uint8_t blackLevel = blackLevelSum / (3 * _obPixels.size());
-
-    // Black level correction
-    for (uint32_t i = 0; i < w * h * ch; i++) {
-        if (outData[i] >= blackLevel)
-            outData[i] -= blackLevel;
-        else
-            outData[i] = 0;
+    const uint32_t blackLevel = blackLevelSum / (3 * camera.obPixels.size());
+
+    for (uint32_t c = 0; c < 3; c++) {
+        for (uint32_t v = 0; v < 256; v++) {
+            camera.plans.degWhiteBalance[c][v] = static_cast<uint8_t>(std::clamp(v * gains[c], 0.0f, 255.0f));
+            camera.plans.degBlackLevel[c][v] = static_cast<uint8_t>(std::min(v + _blackLevelOffset, 255u));
+            camera.plans.proBlackLevel[c][v] = static_cast<uint8_t>(v >= blackLevel ? v - blackLevel : 0);
+            camera.plans.proWhiteBalance[c][v] = static_cast<uint8_t>(std::clamp(v / gains[c], 0.0f, 255.0f));
+        }
     }
-}
 
-void Project::proVignettingCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
+    // Lens shading mesh at integer pixel positions
+    constexpr uint32_t MW = LENS_SHADING_MESH_W;
+    constexpr uint32_t MH = LENS_SHADING_MESH_H;
+    LensShadingPlan& mesh = camera.plans.lensShading;
+    for (uint32_t i = 0; i < MW; i++)
+        mesh.nodeX[i] = i * (w - 1) / (MW - 1);
+    for (uint32_t j = 0; j < MH; j++)
+        mesh.nodeY[j] = j * (h - 1) / (MH - 1);
+    const CalibrationProfile profile = correctionProfile(camera);
+    const bool measured = profile.lensShading.size() == MW * MH;
     atta::vec2 center(w / 2.0f, h / 2.0f);
-    for (uint32_t y = 0; y < h; y++) {
-        for (uint32_t x = 0; x < w; x++) {
-            uint32_t idx = (y * w + x) * ch;
-
-            // Compute normalized radial distance
-            float r = (atta::vec2(x, y) - center).length() / center.length();
-            float r2 = r * r;
-            float r3 = r2 * r;
-            float r4 = r2 * r2;
-
-            // Compute vignetting polynomial
-            float vignetting =
-                _vignettingCoeffs[0] * r4 + _vignettingCoeffs[1] * r3 + _vignettingCoeffs[2] * r2 + _vignettingCoeffs[3] * r + _vignettingCoeffs[4];
-
-            // Apply inverse vignetting to the pixel
-            outData[idx] = static_cast<uint8_t>(std::clamp(inData[idx] / vignetting, 0.0f, 255.0f));
-            outData[idx + 1] = static_cast<uint8_t>(std::clamp(inData[idx + 1] / vignetting, 0.0f, 255.0f));
-            outData[idx + 2] = static_cast<uint8_t>(std::clamp(inData[idx + 2] / vignetting, 0.0f, 255.0f));
+    for (uint32_t j = 0; j < MH; j++) {
+        for (uint32_t i = 0; i < MW; i++) {
+            float r = (atta::vec2(mesh.nodeX[i], mesh.nodeY[j]) - center).length() / center.length();
+            const atta::vec3 gain = measured ? profile.lensShading[j * MW + i] : radialShadingGain(profile, r);
+            for (uint32_t c = 0; c < 3; c++) // Clamped so the fixed point gain (and its product with a pixel value) cannot overflow
+                mesh.gains[j * MW + i][c] = int32_t(std::lround(std::clamp(gain[c], 0.0f, LENS_SHADING_MAX_GAIN) * 65536.0f));
         }
     }
 }
 
-void Project::proChromaticAberrationCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    atta::vec2 center(w / 2.0f, h / 2.0f);
-    for (uint32_t y = 0; y < h; y++) {
-        for (uint32_t x = 0; x < w; x++) {
-            uint32_t idx = (y * w + x) * ch;
-            // Compute normalized radial distance
-            atta::vec2 delta = atta::vec2(x, y) - center;
-            float r = delta.length() / center.length();
-            float r2 = r * r;
-            float r3 = r2 * r;
-
-            // Calculate chromatic aberration displacement for Red channel
-            float displacementR = (_chromaticAberrationCoeffsR[0] * r2 + _chromaticAberrationCoeffsR[1] * r3);
-            float sxR_float = center.x + delta.x * (1.0f - displacementR);
-            float syR_float = center.y + delta.y * (1.0f - displacementR);
+void Project::forEachDeadPixel(const Region& region, uint32_t w, uint32_t ch,
+                               const std::function<void(uint32_t x, uint32_t y, uint32_t c)>& func) const {
+    // The list is sorted, so the dead pixels in the rows of the region are found with a binary search
+    const uint64_t rowSize = uint64_t(w) * ch;
+    const TrackedVector<uint64_t>& deadPixels = camera().deadPixels;
+    auto begin = std::lower_bound(deadPixels.begin(), deadPixels.end(), region.y * rowSize);
+    auto end = std::lower_bound(begin, deadPixels.end(), (region.y + region.h) * rowSize);
+    for (auto it = begin; it != end; ++it) {
+        uint32_t x = uint32_t(*it % rowSize / ch);
+        if (x >= region.x && x < region.x + region.w)
+            func(x, uint32_t(*it / rowSize), uint32_t(*it % ch));
+    }
+}
 
-            // Calculate chromatic aberration displacement for Blue channel
-            float displacementB = (_chromaticAberrationCoeffsB[0] * r2 + _chromaticAberrationCoeffsB[1] * r3);
-            float sxB_float = center.x + delta.x * (1.0f - displacementB);
-            float syB_float = center.y + delta.y * (1.0f - displacementB);
+void Project::degWhiteBalanceError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    applyChannelLuts(camera().plans.degWhiteBalance, inData, outData, ch, tile);
+}
 
-            // Sample from vignettingData (nearest neighbor sampling)
-            // outData[idx + 0] = (uint8_t)nearestNeighborSampling(inData, w, h, ch, sxR_float, syR_float).x;
-            // outData[idx + 1] = inData[(y * w + x) * ch + 1];
-            // outData[idx + 2] = (uint8_t)nearestNeighborSampling(inData, w, h, ch, sxB_float, syB_float).z;
+void Project::degLensDistortion(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    const size_t inStride = tile.inChannelStride();
+    const size_t outStride = tile.outChannelStride();
+    dispatchInterpolation(_interpolation, [&](auto MODE) {
+        dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+            for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+                uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+                for (uint32_t i = 0; i < tile.out.w; i++) {
+                    const uint32_t x = tile.out.x + i;
+
+                    // Compute normalized radial distance
+                    atta::vec2 delta = atta::vec2(x, y) - center;
+                    float r = delta.length() / center.length();
+                    float r2 = r * r;
+                    float r4 = r2 * r2;
+
+                    // Compute barrel distortion polynomial (source radius)
+                    float lensR = r * (_barrelDistortionCoeffs[0] + _barrelDistortionCoeffs[1] * r2 + _barrelDistortionCoeffs[2] * r4);
+
+                    // Compute angle
+                    float angle = 0.0f;
+                    if (delta.squareLength() > 1e-5f)
+                        angle = std::atan2(delta.y, delta.x); // Avoid division by zero at the exact center
+
+                    // Compute source pixel coordinates
+                    float xDist = center.x + lensR * std::cos(angle) * center.length();
+                    float yDist = center.y + lensR * std::sin(angle) * center.length();
+
+                    // Sample distorted coordinate in source image (every channel, alpha moves with the pixel)
+                    auto pixel = samplePixel<MODE, CH>(inData, tile.in.w, tile.in.h, step, xDist - tile.in.x, yDist - tile.in.y, inStride);
+                    for (uint32_t c = 0; c < CH; c++)
+                        outRow[i * step + c * outStride] = static_cast<uint8_t>(pixel[c]);
+                }
+            }
+        });
+    });
+}
 
-            // Sample from vignettingData (bilinear sampling)
-            outData[idx + 0] = (uint8_t)bilinearSampling(inData, w, h, ch, sxR_float, syR_float).x;
-            outData[idx + 1] = inData[(y * w + x) * ch + 1];
-            outData[idx + 2] = (uint8_t)bilinearSampling(inData, w, h, ch, sxB_float, syB_float).z;
+void Project::degColorShadingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    const size_t inStride = tile.inChannelStride();
+    const size_t outStride = tile.outChannelStride();
+    dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+        constexpr uint32_t NC = colorChannels(CH);
+        for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+            const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+            uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+            for (uint32_t i = 0; i < tile.out.w; i++) {
+                const uint32_t x = tile.out.x + i;
+
+                // Compute normalized radial distance
+                float r = (atta::vec2(x, y) - center).length() / center.length();
+
+                // Compute color shading indices
+                uint32_t gainIdx1 = static_cast<uint32_t>(r * (COLOR_SHADING_COUNT - 1));
+                uint32_t gainIdx2 = gainIdx1 + 1;
+                if (gainIdx2 >= COLOR_SHADING_COUNT)
+                    gainIdx2 = COLOR_SHADING_COUNT - 1;
+
+                // Interpolate gain
+                float t = r * (COLOR_SHADING_COUNT - 1) - static_cast<float>(gainIdx1);
+                const atta::vec3& gain1 = _colorShadingError[gainIdx1];
+                const atta::vec3& gain2 = _colorShadingError[gainIdx2];
+                atta::vec3 gain = (1.0f - t) * gain1 + t * gain2;
+
+                // Save shaded pixel
+                for (uint32_t c = 0; c < NC; c++) {
+                    float shaded = inRow[i * step + c * inStride] * gain[parameterChannel(CH, c)];
+                    outRow[i * step + c * outStride] = static_cast<uint8_t>(std::clamp(shaded, 0.0f, 255.0f));
+                }
+                for (uint32_t c = NC; c < CH; c++)
+                    outRow[i * step + c * outStride] = inRow[i * step + c * inStride];
+            }
         }
+    });
+}
+
+void Project::degChromaticAberrationError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    // Mono frames only have the reference (green) channel
+    if (ch == 1) {
+        copyStage(inData, outData, w, h, ch, tile);
+        return;
     }
+
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    const size_t inStride = tile.inChannelStride();
+    const size_t outStride = tile.outChannelStride();
+
+    // Only the red and blue channels are displaced
+    const uint8_t* inR = &inData[tile.inIndex(tile.in.x, tile.in.y, ch, 0)];
+    const uint8_t* inB = &inData[tile.inIndex(tile.in.x, tile.in.y, ch, 2)];
+    dispatchInterpolation(_interpolation, [&](auto MODE) {
+        dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+            for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+                const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+                uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+                for (uint32_t i = 0; i < tile.out.w; i++) {
+                    const uint32_t x = tile.out.x + i;
+
+                    // Compute normalized radial distance
+                    atta::vec2 delta = atta::vec2(x, y) - center;
+                    float r = delta.length() / center.length();
+                    float r2 = r * r;
+                    float r3 = r2 * r;
+
+                    // Calculate chromatic aberration displacement for Red channel
+                    float displacementR = (_chromaticAberrationCoeffsR[0] * r2 + _chromaticAberrationCoeffsR[1] * r3);
+                    float sxR_float = center.x + delta.x * (1.0f + displacementR) - tile.in.x;
+                    float syR_float = center.y + delta.y * (1.0f + displacementR) - tile.in.y;
+
+                    // Calculate chromatic aberration displacement for Blue channel
+                    float displacementB = (_chromaticAberrationCoeffsB[0] * r2 + _chromaticAberrationCoeffsB[1] * r3);
+                    float sxB_float = center.x + delta.x * (1.0f + displacementB) - tile.in.x;
+                    float syB_float = center.y + delta.y * (1.0f + displacementB) - tile.in.y;
+
+                    // Sample the displaced channels, green (and alpha) are copied
+                    uint8_t* outPix = &outRow[i * step];
+                    outPix[0] = (uint8_t)sampleChannel<MODE>(inR, tile.in.w, tile.in.h, step, sxR_float, syR_float);
+                    outPix[outStride] = inRow[i * step + inStride];
+                    outPix[2 * outStride] = (uint8_t)sampleChannel<MODE>(inB, tile.in.w, tile.in.h, step, sxB_float, syB_float);
+                    for (uint32_t c = 3; c < CH; c++)
+                        outPix[c * outStride] = inRow[i * step + c * inStride];
+                }
+            }
+        });
+    });
 }
 
-void Project::proColorShadingCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
+void Project::degVignettingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
     atta::vec2 center(w / 2.0f, h / 2.0f);
-    for (uint32_t y = 0; y < h; y++) {
-        for (uint32_t x = 0; x < w; x++) {
-            uint32_t idx = (y * w + x) * ch;
+    const size_t inStride = tile.inChannelStride();
+    const size_t outStride = tile.outChannelStride();
+    dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+        constexpr uint32_t NC = colorChannels(CH);
+        for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+            const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+            uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+            for (uint32_t i = 0; i < tile.out.w; i++) {
+                const uint32_t x = tile.out.x + i;
+
+                // Compute normalized radial distance
+                float r = (atta::vec2(x, y) - center).length() / center.length();
+                float r2 = r * r;
+                float r3 = r2 * r;
+                float r4 = r2 * r2;
+
+                // Compute vignetting polynomial
+                float vignetting = _vignettingCoeffs[0] * r4 + _vignettingCoeffs[1] * r3 + _vignettingCoeffs[2] * r2 + _vignettingCoeffs[3] * r +
+                                   _vignettingCoeffs[4];
+
+                // Apply vignetting to the color channels
+                for (uint32_t c = 0; c < NC; c++)
+                    outRow[i * step + c * outStride] = static_cast<uint8_t>(std::clamp(inRow[i * step + c * inStride] * vignetting, 0.0f, 255.0f));
+                for (uint32_t c = NC; c < CH; c++)
+                    outRow[i * step + c * outStride] = inRow[i * step + c * inStride];
+            }
+        }
+    });
+}
 
-            // Compute normalized radial distance
-            float r = (atta::vec2(x, y) - center).length() / center.length();
+void Project::degSensorNoise(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    const float shotGain = _shotNoiseGain;
+    const float readVariance = _readNoise * _readNoise;
+    const uint32_t key = randomHash(uint32_t(_sensorNoiseSeed), 0);
+
+    // Each row is independent and has its own random key, so the counter does not overflow for large frames. The counter is the index of the
+    // value among the interleaved color values of the row, so the noise does not depend on the layout or on the alpha channel
+    dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+        constexpr uint32_t NC = colorChannels(CH);
+        parallelFor(tile.out.h, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t y = tile.out.y + begin; y < tile.out.y + end; y++) {
+                const uint32_t rowKey = randomHash(key, y);
+                for (uint32_t c = 0; c < CH; c++) {
+                    const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch, c)];
+                    uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch, c)];
+                    if (c >= NC) {
+                        for (uint32_t i = 0; i < tile.out.w; i++)
+                            outRow[i * step] = inRow[i * step];
+                        continue;
+                    }
+                    const uint32_t counter = tile.out.x * NC + c;
+                    for (uint32_t i = 0; i < tile.out.w; i++) {
+                        float value = inRow[i * step];
+                        float sigma = std::sqrt(shotGain * value + readVariance);
+                        float noisy = value + sigma * randomNormal(rowKey, counter + i * NC);
+                        outRow[i * step] = static_cast<uint8_t>(std::clamp(noisy + 0.5f, 0.0f, 255.0f));
+                    }
+                }
+            }
+        });
+    });
+}
 
-            // Compute color shading indices
-            uint32_t gainIdx1 = static_cast<uint32_t>(r * (COLOR_SHADING_COUNT - 1));
-            uint32_t gainIdx2 = gainIdx1 + 1;
-            if (gainIdx2 >= COLOR_SHADING_COUNT)
-                gainIdx2 = COLOR_SHADING_COUNT - 1;
+void Project::degBlackLevelOffset(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    applyChannelLuts(camera().plans.degBlackLevel, inData, outData, ch, tile);
+}
 
-            // Interpolate gain
-            float t = r * (COLOR_SHADING_COUNT - 1) - static_cast<float>(gainIdx1);
-            const atta::vec3& gain1 = _colorShadingError[gainIdx1];
-            const atta::vec3& gain2 = _colorShadingError[gainIdx2];
-            atta::vec3 gain = (1.0f - t) * gain1 + t * gain2;
+void Project::degDeadPixelInjection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    // Dead pixel injection (set the channels in the dead pixel list to 0 - simulate photosite failure)
+    copyStage(inData, outData, w, h, ch, tile);
+    forEachDeadPixel(tile.out, w, ch, [&](uint32_t x, uint32_t y, uint32_t c) { outData[tile.outIndex(x, y, ch, c)] = 0; });
+}
 
-            const uint8_t* inPix = &inData[idx];
-            atta::vec3 pixel(inPix[0], inPix[1], inPix[2]);
-            atta::vec3 shadedPixel = pixel / gain;
+void Project::proDeadPixelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    // Copy input data to output data
+    copyStage(inData, outData, w, h, ch, tile);
 
-            // Save shaded pixel
-            outData[idx] = static_cast<uint8_t>(std::clamp(shadedPixel.x, 0.0f, 255.0f));
-            outData[idx + 1] = static_cast<uint8_t>(std::clamp(shadedPixel.y, 0.0f, 255.0f));
-            outData[idx + 2] = static_cast<uint8_t>(std::clamp(shadedPixel.z, 0.0f, 255.0f));
+    // Dead pixel correction (nearest neighbor sampling). The input region has a one pixel halo, so the neighbors are always available
+    const uint32_t step = tile.step(ch);
+    const size_t inRowSize = size_t(tile.in.w) * step;
+    forEachDeadPixel(tile.out, w, ch, [&](uint32_t x, uint32_t y, uint32_t c) {
+        const uint8_t* pixel = &inData[tile.inIndex(x, y, ch, c)];
+        uint32_t sum = 0;
+        uint32_t count = 0;
+
+        // TODO should not use neighbor if the neighbor is also a dead pixel
+        if (x > 0) {
+            sum += *(pixel - step);
+            count++;
+        }
+        if (x + 1 < w) {
+            sum += *(pixel + step);
+            count++;
+        }
+        if (y > 0) {
+            sum += *(pixel - inRowSize);
+            count++;
+        }
+        if (y + 1 < h) {
+            sum += *(pixel + inRowSize);
+            count++;
         }
-    }
-}
 
-void Project::proLensCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    atta::vec2 center(w / 2.0f, h / 2.0f);
-    for (uint32_t y = 0; y < h; y++) {
-        for (uint32_t x = 0; x < w; x++) {
-            uint32_t idx = (y * w + x) * ch;
+        // Average of 4 neighbors
+        outData[tile.outIndex(x, y, ch, c)] = sum / count;
+    });
+}
 
-            // Compute normalized radial distance
-            atta::vec2 delta = atta::vec2(x, y) - center;
-            float r = delta.length() / center.length();
-            float r2 = r * r;
-            float r3 = r2 * r;
-            float r4 = r2 * r2;
+void Project::proBlackLevelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    applyChannelLuts(camera().plans.proBlackLevel, inData, outData, ch, tile);
+}
 
-            // Compute inverse barrel distortion polynomial
-            float denom = _barrelDistortionCoeffs[0] + _barrelDistortionCoeffs[1] * r2 + _barrelDistortionCoeffs[2] * r4;
-            if (std::abs(denom) < 1e-3f)
-                denom = 1e-3f; // Avoid division by zero
-            float lensR = r / denom;
+void Project::proNoiseReduction(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    switch (_noiseReductionMode) {
+        case NoiseReductionMode::NONE:
+            copyStage(inData, outData, w, h, ch, tile);
+            break;
+        case NoiseReductionMode::BILATERAL_GRID:
+            bilateralGridDenoise(inData, outData, ch, tile, _noiseReductionStrength, _noiseReductionQuality);
+            break;
+        case NoiseReductionMode::NON_LOCAL_MEANS:
+            nonLocalMeansDenoise(inData, outData, ch, tile, _noiseReductionStrength, _noiseReductionQuality);
+            break;
+    }
+}
 
-            // Compute angle
-            float angle = 0.0f;
-            if (delta.squareLength() > 1e-5f)
-                angle = std::atan2(delta.y, delta.x); // Avoid division by zero at the exact center
+void Project::bilateralGridDenoise(const uint8_t* inData, uint8_t* outData, uint32_t ch, const Tile& tile, float strength, int quality) {
+    dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+        // Only the color channels are filtered, alpha is copied
+        constexpr uint32_t NC = colorChannels(CH);
+
+        // Grid sampling rates (pixels per cell and intensity levels per cell)
+        const float spatialSampling = float(std::max(2, 16 / quality));
+        const float rangeSampling = std::max(1.0f, strength);
+
+        // The grid covers the input region. Cells are aligned to the frame origin, so a tile gets the same cells (and the same result) as the
+        // full frame as long as its halo covers the filter support
+        const Region& in = tile.in;
+        const uint32_t cellX0 = uint32_t(in.x / spatialSampling + 0.5f);
+        const uint32_t cellY0 = uint32_t(in.y / spatialSampling + 0.5f);
+
+        // Grid dimensions, with one cell of padding on each side so the blur does not need bound checks
+        const uint32_t gw = uint32_t((in.x + in.w - 1) / spatialSampling + 0.5f) - cellX0 + 3;
+        const uint32_t gh = uint32_t((in.y + in.h - 1) / spatialSampling + 0.5f) - cellY0 + 3;
+        const uint32_t gd = uint32_t(255.0f / rangeSampling + 0.5f) + 3;
+
+        // Each cell stores the sum of each color channel followed by the weight (homogeneous coordinates)
+        constexpr uint32_t cellSize = NC + 1;
+        const size_t strideZ = cellSize;
+        const size_t strideX = gd * strideZ;
+        const size_t strideY = gw * strideX;
+        TrackedVector<float> grid(gh * strideY, 0.0f);
+
+        // The intensity axis is indexed by the color average, so all channels share the same edges
+        const size_t inStride = tile.inChannelStride();
+        const size_t outStride = tile.outChannelStride();
+        auto guide = [inStride](const uint8_t* pixel) {
+            uint32_t sum = 0;
+            for (uint32_t c = 0; c < NC; c++)
+                sum += pixel[c * inStride];
+            return float(sum) / NC;
+        };
 
-            // Compute source pixel coordinates
-            float xDist = center.x + lensR * std::cos(angle) * center.length();
-            float yDist = center.y + lensR * std::sin(angle) * center.length();
+        // Splat. Each thread owns a range of grid rows, so there is no write contention
+        parallelFor(gh, [&](uint32_t gyBegin, uint32_t gyEnd) {
+            float yBeginF = (float(gyBegin + cellY0) - 1.5f) * spatialSampling;
+            float yEndF = (float(gyEnd + cellY0) - 0.5f) * spatialSampling;
+            uint32_t yBegin = uint32_t(std::clamp(yBeginF, float(in.y), float(in.y + in.h)));
+            uint32_t yEnd = std::min(in.y + in.h, uint32_t(std::max(float(in.y), yEndF)) + 1);
+            for (uint32_t y = yBegin; y < yEnd; y++) {
+                uint32_t gy = uint32_t(y / spatialSampling + 0.5f) - cellY0 + 1;
+                if (gy < gyBegin || gy >= gyEnd)
+                    continue;
+                const uint8_t* row = &inData[tile.inIndex(in.x, y, ch)];
+                for (uint32_t x = 0; x < in.w; x++) {
+                    const uint8_t* pixel = &row[x * step];
+                    uint32_t gx = uint32_t((in.x + x) / spatialSampling + 0.5f) - cellX0 + 1;
+                    uint32_t gz = uint32_t(guide(pixel) / rangeSampling + 0.5f) + 1;
+                    float* cell = &grid[gy * strideY + gx * strideX + gz * strideZ];
+                    for (uint32_t c = 0; c < NC; c++)
+                        cell[c] += pixel[c * inStride];
+                    cell[NC] += 1.0f;
+                }
+            }
+        });
+
+        // Blur with a [1 2 1] kernel along each axis. Lines are enumerated by (u, v) and processed in parallel over u
+        auto blurAxis = [&](uint32_t n, size_t stride, uint32_t nu, size_t strideU, uint32_t nv, size_t strideV) {
+            parallelFor(nu, [&](uint32_t uBegin, uint32_t uEnd) {
+                TrackedVector<float> line(n * cellSize);
+                for (uint32_t u = uBegin; u < uEnd; u++) {
+                    for (uint32_t v = 0; v < nv; v++) {
+                        float* base = &grid[u * strideU + v * strideV];
+                        for (uint32_t i = 0; i < n; i++)
+                            for (uint32_t k = 0; k < cellSize; k++)
+                                line[i * cellSize + k] = base[i * stride + k];
+                        for (uint32_t i = 1; i + 1 < n; i++)
+                            for (uint32_t k = 0; k < cellSize; k++)
+                                base[i * stride + k] =
+                                    (line[(i - 1) * cellSize + k] + 2.0f * line[i * cellSize + k] + line[(i + 1) * cellSize + k]) * 0.25f;
+                    }
+                }
+            });
+        };
+        blurAxis(gd, strideZ, gh, strideY, gw, strideX);
+        blurAxis(gw, strideX, gh, strideY, gd, strideZ);
+        blurAxis(gh, strideY, gw, strideX, gd, strideZ);
+
+        // Slice the output region with trilinear interpolation. Cell coordinates are computed in the frame and then offset to the grid origin
+        parallelFor(tile.out.h, [&](uint32_t begin, uint32_t end) {
+            std::array<float, cellSize> value;
+            for (uint32_t y = tile.out.y + begin; y < tile.out.y + end; y++) {
+                float fy = y / spatialSampling + 1.0f;
+                uint32_t y0 = uint32_t(fy);
+                float ty = fy - y0;
+                y0 -= cellY0;
+                const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+                uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+                for (uint32_t i = 0; i < tile.out.w; i++) {
+                    const uint8_t* pixel = &inRow[i * step];
+                    float fx = (tile.out.x + i) / spatialSampling + 1.0f;
+                    float fz = guide(pixel) / rangeSampling + 1.0f;
+                    uint32_t x0 = uint32_t(fx);
+                    uint32_t z0 = uint32_t(fz);
+                    float tx = fx - x0;
+                    float tz = fz - z0;
+                    x0 -= cellX0;
+
+                    value.fill(0.0f);
+                    for (uint32_t corner = 0; corner < 8; corner++) {
+                        uint32_t dx = corner & 1;
+                        uint32_t dy = (corner >> 1) & 1;
+                        uint32_t dz = (corner >> 2) & 1;
+                        float weight = (dx ? tx : 1.0f - tx) * (dy ? ty : 1.0f - ty) * (dz ? tz : 1.0f - tz);
+                        const float* cell = &grid[(y0 + dy) * strideY + (x0 + dx) * strideX + (z0 + dz) * strideZ];
+                        for (uint32_t k = 0; k < cellSize; k++)
+                            value[k] += weight * cell[k];
+                    }
+
+                    uint8_t* outPixel = &outRow[i * step];
+                    for (uint32_t c = 0; c < NC; c++)
+                        outPixel[c * outStride] =
+                            value[NC] > 1e-5f ? static_cast<uint8_t>(std::clamp(value[c] / value[NC] + 0.5f, 0.0f, 255.0f)) : pixel[c * inStride];
+                    for (uint32_t c = NC; c < CH; c++)
+                        outPixel[c * outStride] = pixel[c * inStride];
+                }
+            }
+        });
+    });
+}
 
-            if (xDist < 0.0f || xDist >= w || yDist < 0.0f || yDist >= h) {
-                // Out of bounds, set to black
-                outData[idx + 0] = 0;
-                outData[idx + 1] = 0;
-                outData[idx + 2] = 0;
-                continue;
+void Project::nonLocalMeansDenoise(const uint8_t* inData, uint8_t* outData, uint32_t ch, const Tile& tile, float strength, int quality) {
+    dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+        // Patch distances and averages only use the color channels, alpha is copied
+        constexpr uint32_t NC = colorChannels(CH);
+        const int searchRadius = quality + 1;
+        const int patchRadius = quality >= 3 ? 2 : 1;
+        const int patchSize = 2 * patchRadius + 1;
+
+        // The filter runs on the input buffer (borders are clamped to the input region) and only the rows of the output region are computed
+        const uint32_t w = tile.in.w;
+        const uint32_t h = tile.in.h;
+        const uint32_t outX = tile.out.x - tile.in.x;
+        const uint32_t outY = tile.out.y - tile.in.y;
+        const size_t inStride = tile.inChannelStride();
+        const size_t outStride = tile.outChannelStride();
+        const size_t rowStride = size_t(w) * step;
+
+        // Rows are processed in bands so the per-offset buffers and the accumulators stay in cache
+        constexpr uint32_t BAND_ROWS = 32;
+        const uint32_t numBands = (tile.out.h + BAND_ROWS - 1) / BAND_ROWS;
+
+        // Weight lookup table indexed by the mean squared patch difference d, with weight = exp(-d / h^2). Patches with d above 4h^2 get zero
+        // weight (exp(-4) < 2%)
+        constexpr uint32_t WEIGHT_LUT_SIZE = 1024;
+        const float h2 = strength * strength;
+        const float maxDist = 4.0f * h2;
+        std::array<float, WEIGHT_LUT_SIZE> weightLut;
+        for (uint32_t i = 0; i < WEIGHT_LUT_SIZE - 1; i++)
+            weightLut[i] = std::exp(-(i * maxDist / (WEIGHT_LUT_SIZE - 1)) / h2);
+        weightLut[WEIGHT_LUT_SIZE - 1] = 0.0f;
+        // Scale from the patch distance sum to the lookup table index
+        const float distToIndex = (WEIGHT_LUT_SIZE - 1) / (maxDist * patchSize * patchSize * NC);
+
+        // Each band copies the input rows it reads into one plane per color channel, padded by searchRadius columns on both sides with the
+        // border values. The row loops then read the neighbors of every pixel at a constant offset, without clamping and for both layouts, and
+        // run on vectors (see squaredDifferenceRow)
+        const uint32_t pad = uint32_t(searchRadius);
+        const uint32_t paddedW = w + 2 * pad;
+        const uint32_t planeRows = BAND_ROWS + 2 * uint32_t(patchRadius + searchRadius);
+        const size_t bandSize = size_t(BAND_ROWS) * w;
+
+        parallelFor(numBands, [&](uint32_t bandBegin, uint32_t bandEnd) {
+            const uint32_t haloRows = BAND_ROWS + 2 * patchRadius;
+            TrackedVector<uint8_t> planes(size_t(NC) * planeRows * paddedW); // Input rows of the band
+            TrackedVector<uint32_t> diff(w + 2 * patchRadius); // Squared difference of one row, with its border values repeated patchRadius times
+            TrackedVector<uint32_t> rowSum(haloRows * w);      // Squared differences box-filtered horizontally
+            TrackedVector<uint32_t> patchDist(w);              // Squared differences box-filtered in both directions (patch distance)
+            TrackedVector<float> weight(w);                    // Weights of one row
+            TrackedVector<float> sumWeight(bandSize);
+            TrackedVector<float> maxWeight(bandSize);
+            TrackedVector<float> sumValue(NC * bandSize); // One plane per color channel
+
+            for (uint32_t band = bandBegin; band < bandEnd; band++) {
+                const uint32_t y0 = outY + band * BAND_ROWS;
+                const uint32_t rows = std::min(BAND_ROWS, outY + tile.out.h - y0);
+                std::fill(sumWeight.begin(), sumWeight.end(), 0.0f);
+                std::fill(maxWeight.begin(), maxWeight.end(), 0.0f);
+                std::fill(sumValue.begin(), sumValue.end(), 0.0f);
+
+                // Rows read by the band: the patch rows and their neighbors, clamped to the input
+                const uint32_t yLow = uint32_t(std::max(int(y0) - patchRadius - searchRadius, 0));
+                const uint32_t yHigh = std::min(h, y0 + rows + uint32_t(patchRadius + searchRadius));
+                for (uint32_t y = yLow; y < yHigh; y++) {
+                    for (uint32_t c = 0; c < NC; c++) {
+                        uint8_t* plane = &planes[(size_t(c) * planeRows + (y - yLow)) * paddedW];
+                        const uint8_t* row = &inData[size_t(y) * rowStride + c * inStride];
+                        for (uint32_t x = 0; x < w; x++)
+                            plane[pad + x] = row[x * step];
+                        std::fill(plane, plane + pad, plane[pad]);
+                        std::fill(plane + pad + w, plane + paddedW, plane[pad + w - 1]);
+                    }
+                }
+                // Pixel x of row y in plane c, shifted by dx
+                auto planeRow = [&](uint32_t c, int y, int dx) { return &planes[(size_t(c) * planeRows + (y - yLow)) * paddedW + pad + dx]; };
+
+                for (int dy = -searchRadius; dy <= searchRadius; dy++) {
+                    for (int dx = -searchRadius; dx <= searchRadius; dx++) {
+                        if (dx == 0 && dy == 0)
+                            continue;
+
+                        // Squared difference between the image and the image shifted by (dx, dy), box-filtered horizontally with clamped
+                        // borders
+                        uint32_t* rowDiff = &diff[patchRadius];
+                        for (uint32_t r = 0; r < rows + 2 * patchRadius; r++) {
+                            int y = std::clamp(int(y0 + r) - patchRadius, 0, int(h) - 1);
+                            int yn = std::clamp(y + dy, 0, int(h) - 1);
+                            for (uint32_t c = 0; c < NC; c++)
+                                squaredDifferenceRow(planeRow(c, y, 0), planeRow(c, yn, dx), rowDiff, w, c > 0);
+                            std::fill(diff.begin(), diff.begin() + patchRadius, rowDiff[0]);
+                            std::fill(diff.end() - patchRadius, diff.end(), rowDiff[w - 1]);
+                            boxFilterRow(diff.data(), &rowSum[r * w], w, patchSize);
+                        }
+
+                        // Vertical sliding sum gives the patch distance, which is converted to a weight and accumulated
+                        std::fill(patchDist.begin(), patchDist.end(), 0u);
+                        for (int k = 0; k < patchSize; k++)
+                            for (uint32_t x = 0; x < w; x++)
+                                patchDist[x] += rowSum[k * w + x];
+                        for (uint32_t r = 0; r < rows; r++) {
+                            int yn = std::clamp(int(y0 + r) + dy, 0, int(h) - 1);
+                            for (uint32_t x = 0; x < w; x++)
+                                weight[x] = weightLut[std::min(uint32_t(patchDist[x] * distToIndex), WEIGHT_LUT_SIZE - 1)];
+                            std::array<const uint8_t*, NC> values;
+                            for (uint32_t c = 0; c < NC; c++)
+                                values[c] = planeRow(c, yn, dx);
+                            accumulateWeightsRow<NC>(weight.data(), values, &sumWeight[r * w], &maxWeight[r * w], &sumValue[r * w], bandSize, w);
+                            if (r + 1 < rows)
+                                for (uint32_t x = 0; x < w; x++)
+                                    patchDist[x] += rowSum[(r + patchSize) * w + x] - rowSum[r * w + x];
+                        }
+                    }
+                }
+
+                // The center pixel gets the largest weight of its neighbors, otherwise it would always dominate the average
+                for (uint32_t r = 0; r < rows; r++) {
+                    uint8_t* outRow = &outData[tile.outIndex(tile.out.x, tile.in.y + y0 + r, ch)];
+                    for (uint32_t x = outX; x < outX + tile.out.w; x++) {
+                        uint32_t i = r * w + x;
+                        float selfWeight = maxWeight[i] > 0.0f ? maxWeight[i] : 1.0f;
+                        float norm = 1.0f / (sumWeight[i] + selfWeight);
+                        const uint8_t* inPixel = &inData[size_t(y0 + r) * rowStride + x * step];
+                        uint8_t* outPixel = &outRow[(x - outX) * step];
+                        for (uint32_t c = 0; c < NC; c++)
+                            outPixel[c * outStride] = static_cast<uint8_t>(
+                                std::clamp((sumValue[c * bandSize + i] + selfWeight * inPixel[c * inStride]) * norm + 0.5f, 0.0f, 255.0f));
+                        for (uint32_t c = NC; c < CH; c++)
+                            outPixel[c * outStride] = inPixel[c * inStride];
+                    }
+                }
             }
+        });
+    });
+}
 
-            // Sample distorted coordinate in source image
-            outData[idx + 0] = static_cast<uint8_t>(bilinearSampling(inData, w, h, ch, xDist, yDist).x);
-            outData[idx + 1] = static_cast<uint8_t>(bilinearSampling(inData, w, h, ch, xDist, yDist).y);
-            outData[idx + 2] = static_cast<uint8_t>(bilinearSampling(inData, w, h, ch, xDist, yDist).z);
+void Project::benchmarkNoiseReduction() {
+    res::Image* inImg = res::get<res::Image>("pro_black_level");
+    uint32_t w = inImg->getWidth();
+    uint32_t h = inImg->getHeight();
+    uint32_t ch = inImg->getChannels();
+    std::vector<uint8_t> outData(size_t(w) * h * ch);
+#ifdef ROW_KERNELS_SIMD
+    LOG_INFO("Noise reduction", "Non-local means row kernels run on vectors of $0 values", SIMD_WIDTH);
+#else
+    LOG_INFO("Noise reduction", "Non-local means row kernels run on scalars (no vector extensions)");
+#endif
+
+    for (int m = 0; m < 2; m++) {
+        for (int q = 1; q <= NOISE_REDUCTION_QUALITY_MAX; q++) {
+            auto start = std::chrono::steady_clock::now();
+            if (m == 0)
+                bilateralGridDenoise(inImg->getData(), outData.data(), ch, fullFrame(w, h), _noiseReductionStrength, q);
+            else
+                nonLocalMeansDenoise(inImg->getData(), outData.data(), ch, fullFrame(w, h), _noiseReductionStrength, q);
+            float time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            _noiseReductionBenchmark[m][q - 1] = time;
+            LOG_INFO("Noise reduction", "$0 quality $1: $2 ms ($3 MP/s)", m == 0 ? "Bilateral grid" : "Non-local means", q, time,
+                     size_t(w) * h / (time * 1000.0f));
         }
     }
 }
 
-void Project::proWhiteBalanceCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    for (uint32_t i = 0; i < w * h; i++) {
-        // Get the RGB values for the current pixel
-        uint8_t r = inData[i * ch];
-        uint8_t g = inData[i * ch + 1];
-        uint8_t b = inData[i * ch + 2];
+void Project::proLensShadingCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    constexpr uint32_t MW = LENS_SHADING_MESH_W;
+    constexpr uint32_t MH = LENS_SHADING_MESH_H;
+    const LensShadingPlan& mesh = camera().plans.lensShading;
+    const size_t inStride = tile.inChannelStride();
+    const size_t outStride = tile.outChannelStride();
+    dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+        constexpr uint32_t NC = colorChannels(CH);
+        parallelFor(tile.out.h, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t y = tile.out.y + begin; y < tile.out.y + end; y++) {
+                // Gains of the row at each mesh column, interpolated between the mesh rows around it
+                uint32_t j = 0;
+                while (j + 2 < MH && mesh.nodeY[j + 1] <= y)
+                    j++;
+                const int64_t dy = y - mesh.nodeY[j];
+                const int64_t cellH = mesh.nodeY[j + 1] - mesh.nodeY[j];
+                // The row gains and the steps along the cells have 16 more fractional bits than the mesh gains (16.32 fixed point), so
+                // stepping along a cell does not accumulate the rounding of the step
+                std::array<std::array<int64_t, 3>, MW> rowGains;
+                for (uint32_t i = 0; i < MW; i++) {
+                    for (uint32_t c = 0; c < 3; c++) {
+                        const int64_t g0 = int64_t(mesh.gains[j * MW + i][c]) << 16;
+                        const int64_t g1 = int64_t(mesh.gains[(j + 1) * MW + i][c]) << 16;
+                        rowGains[i][c] = cellH > 0 ? g0 + (g1 - g0) * dy / cellH : g0;
+                    }
+                }
+
+                const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+                uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+                for (uint32_t i = 0; i + 1 < MW; i++) {
+                    // Pixels of the tile between mesh columns i and i + 1 (the last mesh column belongs to the last cell)
+                    const uint32_t x0 = std::max(mesh.nodeX[i], tile.out.x);
+                    const uint32_t x1 = std::min(i + 2 == MW ? mesh.nodeX[i + 1] + 1 : mesh.nodeX[i + 1], tile.out.x + tile.out.w);
+                    if (x0 >= x1)
+                        continue;
+
+                    // Step the gains along the cell
+                    const int64_t cellW = mesh.nodeX[i + 1] - mesh.nodeX[i];
+                    std::array<int64_t, NC> gain;
+                    std::array<int64_t, NC> delta;
+                    for (uint32_t c = 0; c < NC; c++) {
+                        const uint32_t pc = parameterChannel(CH, c);
+                        delta[c] = cellW > 0 ? (rowGains[i + 1][pc] - rowGains[i][pc]) / cellW : 0;
+                        gain[c] = rowGains[i][pc] + delta[c] * int64_t(x0 - mesh.nodeX[i]);
+                    }
+                    for (uint32_t x = x0; x < x1; x++) {
+                        const size_t k = (x - tile.out.x) * step;
+                        for (uint32_t c = 0; c < NC; c++) {
+                            outRow[k + c * outStride] = uint8_t(std::min<int64_t>((inRow[k + c * inStride] * gain[c]) >> 32, 255));
+                            gain[c] += delta[c];
+                        }
+                        for (uint32_t c = NC; c < CH; c++)
+                            outRow[k + c * outStride] = inRow[k + c * inStride];
+                    }
+                }
+            }
+        });
+    });
+}
 
-        // Apply the temperature gain to each channel
-        const atta::vec3 gains = tempToGain(_colorTemperature);
-        outData[i * ch] = static_cast<uint8_t>(std::clamp(r / gains.x, 0.0f, 255.0f));
-        outData[i * ch + 1] = static_cast<uint8_t>(std::clamp(g / gains.y, 0.0f, 255.0f));
-        outData[i * ch + 2] = static_cast<uint8_t>(std::clamp(b / gains.z, 0.0f, 255.0f));
+void Project::proChromaticAberrationCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch,
+                                               const Tile& tile) const {
+    // Mono frames only have the reference (green) channel
+    if (ch == 1) {
+        copyStage(inData, outData, w, h, ch, tile);
+        return;
     }
+
+    const CalibrationProfile profile = correctionProfile();
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    const size_t inStride = tile.inChannelStride();
+    const size_t outStride = tile.outChannelStride();
+
+    // Only the red and blue channels are displaced
+    const uint8_t* inR = &inData[tile.inIndex(tile.in.x, tile.in.y, ch, 0)];
+    const uint8_t* inB = &inData[tile.inIndex(tile.in.x, tile.in.y, ch, 2)];
+    dispatchInterpolation(_interpolation, [&](auto MODE) {
+        dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+            for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+                const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+                uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+                for (uint32_t i = 0; i < tile.out.w; i++) {
+                    const uint32_t x = tile.out.x + i;
+
+                    // Compute normalized radial distance
+                    atta::vec2 delta = atta::vec2(x, y) - center;
+                    float r = delta.length() / center.length();
+                    float r2 = r * r;
+                    float r3 = r2 * r;
+
+                    // Calculate chromatic aberration displacement for Red channel
+                    float displacementR = (profile.chromaticAberrationCoeffsR[0] * r2 + profile.chromaticAberrationCoeffsR[1] * r3);
+                    float sxR_float = center.x + delta.x * (1.0f - displacementR) - tile.in.x;
+                    float syR_float = center.y + delta.y * (1.0f - displacementR) - tile.in.y;
+
+                    // Calculate chromatic aberration displacement for Blue channel
+                    float displacementB = (profile.chromaticAberrationCoeffsB[0] * r2 + profile.chromaticAberrationCoeffsB[1] * r3);
+                    float sxB_float = center.x + delta.x * (1.0f - displacementB) - tile.in.x;
+                    float syB_float = center.y + delta.y * (1.0f - displacementB) - tile.in.y;
+
+                    // Sample the displaced channels, green (and alpha) are copied
+                    uint8_t* outPix = &outRow[i * step];
+                    outPix[0] = (uint8_t)sampleChannel<MODE>(inR, tile.in.w, tile.in.h, step, sxR_float, syR_float);
+                    outPix[outStride] = inRow[i * step + inStride];
+                    outPix[2 * outStride] = (uint8_t)sampleChannel<MODE>(inB, tile.in.w, tile.in.h, step, sxB_float, syB_float);
+                    for (uint32_t c = 3; c < CH; c++)
+                        outPix[c * outStride] = inRow[i * step + c * inStride];
+                }
+            }
+        });
+    });
+}
+
+void Project::proLensCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    const size_t inStride = tile.inChannelStride();
+    const size_t outStride = tile.outChannelStride();
+    dispatchInterpolation(_interpolation, [&](auto MODE) {
+        dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+            for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+                uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+                for (uint32_t i = 0; i < tile.out.w; i++) {
+                    const uint32_t x = tile.out.x + i;
+
+                    // Compute normalized radial distance
+                    atta::vec2 delta = atta::vec2(x, y) - center;
+                    float r = delta.length() / center.length();
+                    float r2 = r * r;
+                    float r4 = r2 * r2;
+
+                    // Compute inverse barrel distortion polynomial
+                    float denom = _barrelDistortionCoeffs[0] + _barrelDistortionCoeffs[1] * r2 + _barrelDistortionCoeffs[2] * r4;
+                    if (std::abs(denom) < 1e-3f)
+                        denom = 1e-3f; // Avoid division by zero
+                    float lensR = r / denom;
+
+                    // Compute angle
+                    float angle = 0.0f;
+                    if (delta.squareLength() > 1e-5f)
+                        angle = std::atan2(delta.y, delta.x); // Avoid division by zero at the exact center
+
+                    // Compute source pixel coordinates
+                    float xDist = center.x + lensR * std::cos(angle) * center.length();
+                    float yDist = center.y + lensR * std::sin(angle) * center.length();
+
+                    if (xDist < 0.0f || xDist >= w || yDist < 0.0f || yDist >= h) {
+                        // Out of bounds, set to black (and transparent)
+                        for (uint32_t c = 0; c < CH; c++)
+                            outRow[i * step + c * outStride] = 0;
+                        continue;
+                    }
+
+                    // Sample distorted coordinate in source image (every channel, alpha moves with the pixel)
+                    auto pixel = samplePixel<MODE, CH>(inData, tile.in.w, tile.in.h, step, xDist - tile.in.x, yDist - tile.in.y, inStride);
+                    for (uint32_t c = 0; c < CH; c++)
+                        outRow[i * step + c * outStride] = static_cast<uint8_t>(pixel[c]);
+                }
+            }
+        });
+    });
+}
+
+void Project::proWhiteBalanceCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    applyChannelLuts(camera().plans.proWhiteBalance, inData, outData, ch, tile);
 }
 
-void Project::proWhiteBalanceCorrectionAuto(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const {
-    // Implementation of the white patch auto white balance correction
+void Project::proWhiteBalanceCorrectionAuto(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    // Implementation of the white patch auto white balance correction. The statistics are computed over the processed region, so this
+    // stage should only be used on the full frame. Mono frames have no color cast to correct
+    if (ch < 3) {
+        copyStage(inData, outData, w, h, ch, tile);
+        return;
+    }
+
+    const uint32_t step = tile.step(ch);
+    const size_t inStride = tile.inChannelStride();
+    const size_t outStride = tile.outChannelStride();
 
     // Pass 1: Find the brightest pixel in the image
     float maxLuminance = 0.0f;
-    for (uint32_t i = 0; i < w * h; ++i) {
-        float r = static_cast<float>(inData[i * ch + 0]);
-        float g = static_cast<float>(inData[i * ch + 1]);
-        float b = static_cast<float>(inData[i * ch + 2]);
-
-        // Simple luminance approximation (average of channels)
-        float luminance = (r + g + b) / 3.0f;
-        maxLuminance = std::max(maxLuminance, luminance);
+    for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+        const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+        for (uint32_t i = 0; i < tile.out.w; ++i) {
+            float r = static_cast<float>(inRow[i * step]);
+            float g = static_cast<float>(inRow[i * step + inStride]);
+            float b = static_cast<float>(inRow[i * step + 2 * inStride]);
+
+            // Simple luminance approximation (average of channels)
+            float luminance = (r + g + b) / 3.0f;
+            maxLuminance = std::max(maxLuminance, luminance);
+        }
     }
 
     // If image is too dark, skip correction
     if (maxLuminance <= 30.0f) {
         LOG_INFO("AWB", "Image is too dark for white balance correction, skipping. $0", maxLuminance);
-        for (uint32_t i = 0; i < w * h * ch; ++i)
-            outData[i] = inData[i]; // No correction needed
+        copyStage(inData, outData, w, h, ch, tile); // No correction needed
         return;
     }
 
@@ -775,23 +2033,26 @@ void Project::proWhiteBalanceCorrectionAuto(const uint8_t* inData, uint8_t* outD
     // This prevents highly saturated bright colors from being mistaken for white
     float colorDiffThreshold = 50.0f;
 
-    for (uint32_t i = 0; i < w * h; ++i) {
-        float r = static_cast<float>(inData[i * ch + 0]);
-        float g = static_cast<float>(inData[i * ch + 1]);
-        float b = static_cast<float>(inData[i * ch + 2]);
-        float luminance = (r + g + b) / 3.0f;
-
-        // Check if pixel is bright enough
-        if (luminance >= luminanceThreshold) {
-            // Check if pixel is "near white" by examining channel differences
-            float minChannel = std::min({r, g, b});
-            float maxChannel = std::max({r, g, b});
-
-            if ((maxChannel - minChannel) <= colorDiffThreshold) {
-                sumR += r;
-                sumG += g;
-                sumB += b;
-                countBrightPixels++;
+    for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+        const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+        for (uint32_t i = 0; i < tile.out.w; ++i) {
+            float r = static_cast<float>(inRow[i * step]);
+            float g = static_cast<float>(inRow[i * step + inStride]);
+            float b = static_cast<float>(inRow[i * step + 2 * inStride]);
+            float luminance = (r + g + b) / 3.0f;
+
+            // Check if pixel is bright enough
+            if (luminance >= luminanceThreshold) {
+                // Check if pixel is "near white" by examining channel differences
+                float minChannel = std::min({r, g, b});
+                float maxChannel = std::max({r, g, b});
+
+                if ((maxChannel - minChannel) <= colorDiffThreshold) {
+                    sumR += r;
+                    sumG += g;
+                    sumB += b;
+                    countBrightPixels++;
+                }
             }
         }
     }
@@ -816,115 +2077,3415 @@ void Project::proWhiteBalanceCorrectionAuto(const uint8_t* inData, uint8_t* outD
     } else {
         LOG_INFO("AWB", "Not enough bright pixels found for white balance correction, skipping. $0", countBrightPixels);
         // If not enough bright pixels were found, skip correction
-        for (uint32_t i = 0; i < w * h * ch; ++i)
-            outData[i] = inData[i]; // No correction needed
+        copyStage(inData, outData, w, h, ch, tile); // No correction needed
         return;
     }
 
     // Pass 3: Apply scaling factors to the entire image
-    for (uint32_t i = 0; i < w * h; ++i) {
-        float r = static_cast<float>(inData[i * ch + 0]);
-        float g = static_cast<float>(inData[i * ch + 1]);
-        float b = static_cast<float>(inData[i * ch + 2]);
-
-        // Apply scales to R and B channels
-        float outR = r * scaleR;
-        float outB = b * scaleB;
+    for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+        const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+        uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+        for (uint32_t i = 0; i < tile.out.w; ++i) {
+            float r = static_cast<float>(inRow[i * step]);
+            float g = static_cast<float>(inRow[i * step + inStride]);
+            float b = static_cast<float>(inRow[i * step + 2 * inStride]);
+
+            // Apply scales to R and B channels
+            float outR = r * scaleR;
+            float outB = b * scaleB;
+
+            // Clamp values to 0-255 range and cast to uint8_t
+            outRow[i * step] = static_cast<uint8_t>(std::clamp(outR, 0.0f, 255.0f));
+            outRow[i * step + outStride] = static_cast<uint8_t>(std::clamp(g, 0.0f, 255.0f));
+            outRow[i * step + 2 * outStride] = static_cast<uint8_t>(std::clamp(outB, 0.0f, 255.0f));
+            for (uint32_t c = 3; c < ch; c++)
+                outRow[i * step + c * outStride] = inRow[i * step + c * inStride];
+        }
+    }
+}
 
-        // Clamp values to 0-255 range and cast to uint8_t
-        outData[i * ch + 0] = static_cast<uint8_t>(std::clamp(outR, 0.0f, 255.0f));
-        outData[i * ch + 1] = static_cast<uint8_t>(std::clamp(g, 0.0f, 255.0f));
-        outData[i * ch + 2] = static_cast<uint8_t>(std::clamp(outB, 0.0f, 255.0f));
+void Project::proColorCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    switch (_colorLutMode) {
+        case ColorLutMode::IDENTITY:
+            copyStage(inData, outData, w, h, ch, tile);
+            break;
+        case ColorLutMode::CURVE_SRGB:
+        case ColorLutMode::CURVE: {
+            // Per-channel table lookup
+            std::array<const uint8_t*, 3> curves;
+            for (uint32_t c = 0; c < 3; c++)
+                curves[c] = _colorLutMode == ColorLutMode::CURVE_SRGB ? SRGB_CURVE.data() : _colorCurve[c].data();
+            applyChannelLuts(curves, inData, outData, ch, tile);
+            break;
+        }
+        case ColorLutMode::LUT_3D: {
+            // Grid cell and position inside the cell for each 8-bit value, so there is no division per pixel
+            const uint32_t dim = _colorLutDim;
+            std::array<uint32_t, 256> cellIdx;
+            std::array<float, 256> cellFrac;
+            for (uint32_t v = 0; v < 256; v++) {
+                float pos = v * (dim - 1) / 255.0f;
+                cellIdx[v] = std::min(uint32_t(pos), dim - 2);
+                cellFrac[v] = pos - cellIdx[v];
+            }
+            const uint32_t strideG = dim * 3;
+            const uint32_t strideB = dim * dim * 3;
+            const uint8_t* output = _colorLutOutput.data();
+            const size_t inStride = tile.inChannelStride();
+            const size_t outStride = tile.outChannelStride();
+
+            dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+                constexpr uint32_t NC = colorChannels(CH);
+                parallelFor(tile.out.h, [&](uint32_t begin, uint32_t end) {
+                    for (uint32_t y = tile.out.y + begin; y < tile.out.y + end; y++) {
+                        const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch)];
+                        uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch)];
+                        if constexpr (NC == 1) {
+                            // Mono values lie on the gray diagonal of the LUT, where the tetrahedral interpolation reduces to the two corners
+                            // of the diagonal. The green output is used
+                            for (uint32_t i = 0; i < tile.out.w; i++) {
+                                const uint8_t v = inRow[i * step];
+                                const uint16_t* c000 = &_colorLut[cellIdx[v] * (3 + strideG + strideB)];
+                                const uint16_t* c111 = c000 + 3 + strideG + strideB;
+                                float f = cellFrac[v];
+                                outRow[i * step] = output[uint32_t((1.0f - f) * c000[1] + f * c111[1] + 0.5f)];
+                            }
+                            continue;
+                        }
+                        for (uint32_t i = 0; i < tile.out.w; i++) {
+                            const uint8_t* inPix = &inRow[i * step];
+                            uint8_t* outPix = &outRow[i * step];
+                            const uint8_t r = inPix[0];
+                            const uint8_t g = inPix[inStride];
+                            const uint8_t b = inPix[2 * inStride];
+                            float fr = cellFrac[r];
+                            float fg = cellFrac[g];
+                            float fb = cellFrac[b];
+                            const uint16_t* c000 = &_colorLut[cellIdx[r] * 3 + cellIdx[g] * strideG + cellIdx[b] * strideB];
+                            const uint16_t* c111 = c000 + 3 + strideG + strideB;
+
+                            // Tetrahedral interpolation: the cell is split in 6 tetrahedra along the main diagonal, and the one containing the
+                            // point is selected by sorting the fractional coordinates. Only 4 of the 8 corners are read
+                            const uint16_t* c1;
+                            const uint16_t* c2;
+                            float w0, w1, w2, w3;
+                            if (fr > fg) {
+                                if (fg > fb) { // r > g > b
+                                    c1 = c000 + 3;
+                                    c2 = c000 + 3 + strideG;
+                                    w0 = 1.0f - fr, w1 = fr - fg, w2 = fg - fb, w3 = fb;
+                                } else if (fr > fb) { // r > b > g
+                                    c1 = c000 + 3;
+                                    c2 = c000 + 3 + strideB;
+                                    w0 = 1.0f - fr, w1 = fr - fb, w2 = fb - fg, w3 = fg;
+                                } else { // b > r > g
+                                    c1 = c000 + strideB;
+                                    c2 = c000 + 3 + strideB;
+                                    w0 = 1.0f - fb, w1 = fb - fr, w2 = fr - fg, w3 = fg;
+                                }
+                            } else {
+                                if (fb > fg) { // b > g > r
+                                    c1 = c000 + strideB;
+                                    c2 = c000 + strideG + strideB;
+                                    w0 = 1.0f - fb, w1 = fb - fg, w2 = fg - fr, w3 = fr;
+                                } else if (fb > fr) { // g > b > r
+                                    c1 = c000 + strideG;
+                                    c2 = c000 + strideG + strideB;
+                                    w0 = 1.0f - fg, w1 = fg - fb, w2 = fb - fr, w3 = fr;
+                                } else { // g > r > b
+                                    c1 = c000 + strideG;
+                                    c2 = c000 + 3 + strideG;
+                                    w0 = 1.0f - fg, w1 = fg - fr, w2 = fr - fb, w3 = fb;
+                                }
+                            }
+                            for (uint32_t c = 0; c < 3; c++)
+                                outPix[c * outStride] = output[uint32_t(w0 * c000[c] + w1 * c1[c] + w2 * c2[c] + w3 * c111[c] + 0.5f)];
+                            for (uint32_t c = 3; c < CH; c++)
+                                outPix[c * outStride] = inPix[c * inStride];
+                        }
+                    }
+                });
+            });
+            break;
+        }
     }
 }
 
-atta::vec3 Project::tempToGain(float temp) {
-    // Clamp temperature to the table's range
-    if (temp <= TEMPERATURE_GAIN_MIN)
-        return _temperatureGainMap[0];
-    if (temp >= TEMPERATURE_GAIN_MAX)
-        return _temperatureGainMap[TEMPERATURE_GAIN_COUNT - 1];
+Project::PolyphaseFilter Project::polyphaseFilter(uint32_t inSize, uint32_t outSize) {
+    PolyphaseFilter filter;
+    filter.inSize = inSize;
+    filter.outSize = outSize;
+
+    // The Lanczos kernel is stretched by the downscale factor, so its cutoff is the output Nyquist frequency
+    const float scale = float(inSize) / float(outSize); // Input pixels per output pixel
+    const float stretch = std::max(1.0f, scale);
+    const uint32_t halfTaps = uint32_t(std::ceil(SCALER_LOBES * stretch));
+    filter.taps = 2 * halfTaps;
+    constexpr float PI = 3.14159265f;
+    auto lanczos = [](float x) {
+        if (x == 0.0f)
+            return 1.0f;
+        if (std::abs(x) >= SCALER_LOBES)
+            return 0.0f;
+        const float px = PI * x;
+        return SCALER_LOBES * std::sin(px) * std::sin(px / SCALER_LOBES) / (px * px);
+    };
 
-    // Calculate the fractional index in the table
-    float fractionalIndex = (temp - TEMPERATURE_GAIN_MIN) / TEMPERATURE_GAIN_STEP;
+    // Coefficients of each phase. Phase p has its center p / SCALER_PHASES pixels after input pixel halfTaps - 1
+    filter.coeffs.resize(SCALER_PHASES * filter.taps);
+    for (uint32_t p = 0; p < SCALER_PHASES; p++) {
+        float* coeffs = &filter.coeffs[p * filter.taps];
+        float sum = 0.0f;
+        for (uint32_t t = 0; t < filter.taps; t++)
+            sum += coeffs[t] = lanczos((float(t) - float(halfTaps - 1) - float(p) / SCALER_PHASES) / stretch);
+        for (uint32_t t = 0; t < filter.taps; t++)
+            coeffs[t] /= sum;
+    }
 
-    uint32_t index1 = static_cast<uint32_t>(fractionalIndex);
-    uint32_t index2 = index1 + 1;
+    // Input position of each output pixel center, split into the first tap and the phase
+    filter.start.resize(outSize);
+    filter.phase.resize(outSize);
+    for (uint32_t o = 0; o < outSize; o++) {
+        const float center = (o + 0.5f) * scale - 0.5f;
+        int32_t base = int32_t(std::floor(center));
+        uint32_t phase = uint32_t(std::lround((center - base) * SCALER_PHASES));
+        if (phase == SCALER_PHASES) {
+            base++;
+            phase = 0;
+        }
+        filter.start[o] = base - int32_t(halfTaps - 1);
+        filter.phase[o] = phase;
+    }
+    return filter;
+}
 
-    // Basic bounds check (should be mostly covered by temp clamping)
-    if (index1 >= TEMPERATURE_GAIN_COUNT)
-        index1 = TEMPERATURE_GAIN_COUNT - 1;
-    if (index2 >= TEMPERATURE_GAIN_COUNT)
-        index2 = TEMPERATURE_GAIN_COUNT - 1;
+void Project::runScaler(const uint8_t* inData, uint32_t w, uint32_t h, uint32_t ch, bool planar) {
+    // Output sizes (keeping the aspect ratio like the thumbnails) and their filters
+    res::Image* thumb = res::get<res::Image>(_scalerStage + "_thumb");
+    for (ScalerOutput& output : _scalerOutputs) {
+        const float scale = std::min(1.0f, float(output.maxSize) / float(std::max(w, h)));
+        output.w = output.name.empty() ? thumb->getWidth() : std::max(1u, uint32_t(std::round(w * scale)));
+        output.h = output.name.empty() ? thumb->getHeight() : std::max(1u, uint32_t(std::round(h * scale)));
+        if (output.filterX.inSize != w || output.filterX.outSize != output.w)
+            output.filterX = polyphaseFilter(w, output.w);
+        if (output.filterY.inSize != h || output.filterY.outSize != output.h)
+            output.filterY = polyphaseFilter(h, output.h);
+        for (TrackedVector<uint8_t>& buffer : output.data)
+            buffer.resize(size_t(output.w) * output.h * ch);
+    }
 
-    const atta::vec3& gains1 = _temperatureGainMap[index1];
-    const atta::vec3& gains2 = _temperatureGainMap[index2];
+    const Tile in = fullFrame(w, h, planar);
+    const size_t inStride = in.inChannelStride();
+    dispatchLayout(planar, ch, [&](auto CH, auto step) {
+        parallelFor((h + SCALER_BAND_ROWS - 1) / SCALER_BAND_ROWS, [&](uint32_t bandBegin, uint32_t bandEnd) {
+            // Horizontally filtered rows of each output (interleaved floats), reused by the bands of this job
+            std::vector<TrackedVector<float>> rows(_scalerOutputs.size());
+            auto clampRow = [h](int32_t y) { return uint32_t(std::clamp(y, 0, int32_t(h) - 1)); };
+
+            for (uint32_t band = bandBegin; band < bandEnd; band++) {
+                const uint32_t y0 = band * SCALER_BAND_ROWS;
+                const uint32_t y1 = std::min(h, y0 + SCALER_BAND_ROWS);
+
+                // Output rows of the band (rows whose center is in the band) and the input rows they read
+                struct Range {
+                    uint32_t outBegin, outEnd; // Output rows
+                    uint32_t inBegin, inEnd;   // Input rows
+                };
+                std::vector<Range> ranges(_scalerOutputs.size());
+                uint32_t inBegin = h, inEnd = 0;
+                for (size_t o = 0; o < _scalerOutputs.size(); o++) {
+                    const PolyphaseFilter& f = _scalerOutputs[o].filterY;
+                    const int32_t centerOffset = int32_t(f.taps / 2) - 1;
+                    auto outRow = [&](uint32_t y) {
+                        auto it = std::partition_point(f.start.begin(), f.start.end(), [&](int32_t s) { return clampRow(s + centerOffset) < y; });
+                        return uint32_t(it - f.start.begin());
+                    };
+                    Range& r = ranges[o];
+                    r.outBegin = outRow(y0);
+                    r.outEnd = y1 == h ? f.outSize : outRow(y1);
+                    if (r.outBegin == r.outEnd)
+                        continue;
+                    r.inBegin = clampRow(f.start[r.outBegin]);
+                    r.inEnd = clampRow(f.start[r.outEnd - 1] + int32_t(f.taps) - 1) + 1;
+                    inBegin = std::min(inBegin, r.inBegin);
+                    inEnd = std::max(inEnd, r.inEnd);
+                    rows[o].resize(size_t(r.inEnd - r.inBegin) * _scalerOutputs[o].w * CH);
+                }
+
+                // Read each input row once and filter it horizontally for every output that needs it
+                for (uint32_t y = inBegin; y < inEnd; y++) {
+                    const uint8_t* inRow = &inData[in.inIndex(0, y, CH)];
+                    for (size_t o = 0; o < _scalerOutputs.size(); o++) {
+                        const Range& r = ranges[o];
+                        if (r.outBegin == r.outEnd || y < r.inBegin || y >= r.inEnd)
+                            continue;
+                        const PolyphaseFilter& f = _scalerOutputs[o].filterX;
+                        float* row = &rows[o][size_t(y - r.inBegin) * f.outSize * CH];
+                        for (uint32_t ox = 0; ox < f.outSize; ox++) {
+                            const float* coeffs = &f.coeffs[f.phase[ox] * f.taps];
+                            const bool inside = f.start[ox] >= 0 && f.start[ox] + int32_t(f.taps) <= int32_t(w);
+                            std::array<float, CH> sum{};
+                            for (uint32_t t = 0; t < f.taps; t++) {
+                                const int32_t x = inside ? f.start[ox] + int32_t(t) : std::clamp(f.start[ox] + int32_t(t), 0, int32_t(w) - 1);
+                                const uint8_t* pixel = &inRow[x * step];
+                                for (uint32_t c = 0; c < CH; c++)
+                                    sum[c] += coeffs[t] * pixel[c * inStride];
+                            }
+                            for (uint32_t c = 0; c < CH; c++)
+                                row[ox * CH + c] = sum[c];
+                        }
+                    }
+                }
+
+                // Filter the output rows of the band vertically
+                for (size_t o = 0; o < _scalerOutputs.size(); o++) {
+                    ScalerOutput& output = _scalerOutputs[o];
+                    const Range& r = ranges[o];
+                    const PolyphaseFilter& f = output.filterY;
+                    const Tile out = fullFrame(output.w, output.h, planar);
+                    const size_t outStride = out.outChannelStride();
+                    for (uint32_t oy = r.outBegin; oy < r.outEnd; oy++) {
+                        const float* coeffs = &f.coeffs[f.phase[oy] * f.taps];
+                        uint8_t* outRow = &output.data[0][out.outIndex(0, oy, CH)];
+                        for (uint32_t ox = 0; ox < output.w; ox++) {
+                            std::array<float, CH> sum{};
+                            for (uint32_t t = 0; t < f.taps; t++) {
+                                const float* value = &rows[o][(size_t(clampRow(f.start[oy] + int32_t(t)) - r.inBegin) * output.w + ox) * CH];
+                                for (uint32_t c = 0; c < CH; c++)
+                                    sum[c] += coeffs[t] * value[c];
+                            }
+                            for (uint32_t c = 0; c < CH; c++)
+                                outRow[ox * step + c * outStride] = uint8_t(std::clamp(std::lround(sum[c]), 0l, 255l));
+                        }
+                    }
+                }
+            }
+        });
+    });
+}
 
-    // Calculate the interpolation factor (t)
-    float t = fractionalIndex - static_cast<float>(index1);
+void Project::processScalerOutputs(size_t firstStage, uint32_t ch, bool planar) {
+    res::Image::CreateInfo info;
+    info.format = res::Image::Format::RGB8;
+    for (ScalerOutput& output : _scalerOutputs) {
+        // Stages after the scaler, alternating between the output buffers
+        const Tile frame = fullFrame(output.w, output.h, planar);
+        const size_t pixels = size_t(output.w) * output.h;
+        int in = 0;
+        for (size_t s = firstStage - 1; s < _stages.size(); s++) {
+            if (s >= firstStage) {
+                (this->*_stages[s].func)(output.data[in].data(), output.data[in ^ 1].data(), output.w, output.h, ch, frame);
+                in ^= 1;
+            }
+            if (output.name.empty()) {
+                res::Image* thumb = res::get<res::Image>(_stages[s].name + "_thumb");
+                frameToImage(output.data[in].data(), ch, planar, thumb->getData(), thumb->getChannels(), pixels);
+            }
+        }
+        if (output.name.empty())
+            continue;
+
+        // Output image
+        const std::string name = "pro_output_" + output.name;
+        res::Image* img = res::get<res::Image>(name);
+        if (img == nullptr) {
+            info.width = output.w;
+            info.height = output.h;
+            img = res::create<res::Image>(name, info);
+        } else if (img->getWidth() != output.w || img->getHeight() != output.h) {
+            img->resize(output.w, output.h);
+        }
+        frameToImage(output.data[in].data(), ch, planar, img->getData(), img->getChannels(), pixels);
+        img->update();
+    }
+}
 
-    // Linear interpolation
-    return (1.0f - t) * gains1 + t * gains2;
+void Project::copyStage(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const {
+    // One copy per row (interleaved) or per plane row (planar)
+    const uint32_t spans = tile.planar ? ch : 1;
+    const size_t spanSize = tile.planar ? tile.out.w : size_t(tile.out.w) * ch;
+    for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++)
+        for (uint32_t c = 0; c < spans; c++)
+            std::memcpy(&outData[tile.outIndex(tile.out.x, y, ch, c)], &inData[tile.inIndex(tile.out.x, y, ch, c)], spanSize);
 }
 
-atta::vec3 Project::nearestNeighborSampling(const uint8_t* data, uint32_t w, uint32_t h, uint32_t ch, float x, float y) {
-    atta::vec3 result;
+void Project::applyChannelLuts(const std::array<const uint8_t*, 3>& luts, const uint8_t* inData, uint8_t* outData, uint32_t ch,
+                               const Tile& tile) {
+    dispatchLayout(tile.planar, ch, [&](auto CH, auto step) {
+        constexpr uint32_t NC = colorChannels(CH);
+        for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++) {
+            for (uint32_t c = 0; c < CH; c++) {
+                const uint8_t* inRow = &inData[tile.inIndex(tile.out.x, y, ch, c)];
+                uint8_t* outRow = &outData[tile.outIndex(tile.out.x, y, ch, c)];
+                if (c < NC) {
+                    const uint8_t* lut = luts[parameterChannel(CH, c)];
+                    for (uint32_t i = 0; i < tile.out.w; i++)
+                        outRow[i * step] = lut[inRow[i * step]];
+                } else {
+                    for (uint32_t i = 0; i < tile.out.w; i++)
+                        outRow[i * step] = inRow[i * step];
+                }
+            }
+        }
+    });
+}
 
-    // Convert to integer coordinates and clamp (Nearest Neighbor sampling)
-    uint32_t sx = std::clamp(int(std::round(x)), 0, int(w) - 1);
-    uint32_t sy = std::clamp(int(std::round(y)), 0, int(h) - 1);
+float Project::maxRadialDisplacement(const Region& region, uint32_t w, uint32_t h, const std::function<float(float r)>& sourceRadius) {
+    // Range of normalized radial distances covered by the region (closest point and farthest corner)
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    atta::vec2 nearest(std::max({float(region.x) - center.x, center.x - float(region.x + region.w), 0.0f}),
+                       std::max({float(region.y) - center.y, center.y - float(region.y + region.h), 0.0f}));
+    atta::vec2 farthest(std::max(std::abs(float(region.x) - center.x), std::abs(float(region.x + region.w) - center.x)),
+                        std::max(std::abs(float(region.y) - center.y), std::abs(float(region.y + region.h) - center.y)));
+    float rMin = nearest.length() / center.length();
+    float rMax = farthest.length() / center.length();
+
+    // The radial models are smooth polynomials, so sampling the range is enough (callers add a margin)
+    constexpr int SAMPLES = 64;
+    float displacement = 0.0f;
+    for (int i = 0; i <= SAMPLES; i++) {
+        float r = rMin + (rMax - rMin) * i / SAMPLES;
+        displacement = std::max(displacement, std::abs(sourceRadius(r) - r));
+    }
+    return displacement * center.length();
+}
 
-    // Calculate source pixel index
-    uint32_t srcIdx = (sy * w + sx) * ch;
+uint32_t Project::degLensHalo(const Region& region, uint32_t w, uint32_t h) const {
+    const std::array<float, 3>& k = _barrelDistortionCoeffs;
+    float displacement = maxRadialDisplacement(region, w, h, [&](float r) { return r * (k[0] + k[1] * r * r + k[2] * r * r * r * r); });
+    return uint32_t(std::ceil(displacement)) + 2; // Bilinear sampling reads the next pixel, plus one pixel of margin
+}
 
-    // Sample from source image
-    result[0] = data[srcIdx + 0];
-    result[1] = data[srcIdx + 1];
-    result[2] = data[srcIdx + 2];
+uint32_t Project::degChromaticAberrationHalo(const Region& region, uint32_t w, uint32_t h) const {
+    auto displacement = [&](const std::array<float, 2>& c) {
+        return maxRadialDisplacement(region, w, h, [&](float r) { return r * (1.0f + c[0] * r * r + c[1] * r * r * r); });
+    };
+    return uint32_t(std::ceil(std::max(displacement(_chromaticAberrationCoeffsR), displacement(_chromaticAberrationCoeffsB)))) + 2;
+}
 
-    return result;
+uint32_t Project::deadPixelHalo(const Region& region, uint32_t w, uint32_t h) const {
+    return 1; // 4-neighborhood
 }
 
-atta::vec3 Project::bilinearSampling(const uint8_t* data, uint32_t w, uint32_t h, uint32_t ch, float x, float y) {
-    // Determine the integer coordinates of the top-left pixel of the 2x2 grid
-    int x0 = static_cast<int>(std::floor(x));
-    int y0 = static_cast<int>(std::floor(y));
-    int x1 = x0 + 1;
-    int y1 = y0 + 1;
+uint32_t Project::noiseReductionHalo(const Region& region, uint32_t w, uint32_t h) const {
+    // Same parameters as bilateralGridDenoise and nonLocalMeansDenoise
+    const int quality = _noiseReductionQuality;
+    switch (_noiseReductionMode) {
+        case NoiseReductionMode::NONE:
+            return 0;
+        case NoiseReductionMode::BILATERAL_GRID:
+            // Splat (half cell), blur (one cell) and slice (one cell), rounded up
+            return 3 * uint32_t(std::max(2, 16 / quality));
+        case NoiseReductionMode::NON_LOCAL_MEANS:
+            return uint32_t(quality + 1) + (quality >= 3 ? 2 : 1); // Search radius + patch radius
+    }
+    return 0;
+}
 
-    // Calculate fractional parts for interpolation
-    float fx = x - static_cast<float>(x0);
-    float fy = y - static_cast<float>(y0);
+uint32_t Project::proChromaticAberrationHalo(const Region& region, uint32_t w, uint32_t h) const {
+    const CalibrationProfile profile = correctionProfile();
+    auto displacement = [&](const std::array<float, 2>& c) {
+        return maxRadialDisplacement(region, w, h, [&](float r) { return r * (1.0f - c[0] * r * r - c[1] * r * r * r); });
+    };
+    float maxDisplacement = std::max(displacement(profile.chromaticAberrationCoeffsR), displacement(profile.chromaticAberrationCoeffsB));
+    return uint32_t(std::ceil(maxDisplacement)) + 2;
+}
 
-    // Helper lambda to get pixel value with clamping and conversion to float atta::vec3
-    auto get_pixel = [&](int xi, int yi) {
-        // Clamp coordinates to be within image bounds
-        int clamped_x = std::clamp(xi, 0, static_cast<int>(w) - 1);
-        int clamped_y = std::clamp(yi, 0, static_cast<int>(h) - 1);
+uint32_t Project::proLensHalo(const Region& region, uint32_t w, uint32_t h) const {
+    const std::array<float, 3>& k = _barrelDistortionCoeffs;
+    float displacement = maxRadialDisplacement(region, w, h, [&](float r) {
+        float denom = k[0] + k[1] * r * r + k[2] * r * r * r * r;
+        if (std::abs(denom) < 1e-3f)
+            denom = 1e-3f;
+        float lensR = r / denom;
+        return std::abs(lensR) > 1.0f ? r : lensR; // Sources outside the frame are not read (the output is black)
+    });
+    return uint32_t(std::ceil(displacement)) + 2;
+}
 
-        uint32_t idx = (clamped_y * w + clamped_x) * ch;
+float Project::applyToneCurve(float value) const {
+    // Transfer curve (linear to encoded)
+    switch (_transferCurve) {
+        case TransferCurve::LINEAR:
+            break;
+        case TransferCurve::SRGB:
+            value = value <= 0.0031308f ? 12.92f * value : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            break;
+        case TransferCurve::GAMMA:
+            value = std::pow(value, 1.0f / _gamma);
+            break;
+    }
 
-        // Assuming ch >= 3 for R, G, B
-        return atta::vec3(static_cast<float>(data[idx + 0]), // R
-                          static_cast<float>(data[idx + 1]), // G
-                          static_cast<float>(data[idx + 2])  // B
-        );
-    };
+    // S-curve, blend between the identity and smoothstep
+    float smooth = value * value * (3.0f - 2.0f * value);
+    return std::clamp(value + _toneContrast * (smooth - value), 0.0f, 1.0f);
+}
 
-    // Get the color values of the four surrounding pixels
-    atta::vec3 q00 = get_pixel(x0, y0); // Top-left
-    atta::vec3 q10 = get_pixel(x1, y0); // Top-right
-    atta::vec3 q01 = get_pixel(x0, y1); // Bottom-left
-    atta::vec3 q11 = get_pixel(x1, y1); // Bottom-right
+void Project::buildColorLut() {
+    _colorLutDirty = false;
 
-    // Interpolate along the x-axis for the top row
-    atta::vec3 p0 = q00 * (1.0f - fx) + q10 * fx;
+    // LUT loaded from file, nothing to build
+    if (!_colorLutFile.empty()) {
+        _colorLutMode = ColorLutMode::LUT_3D;
+        return;
+    }
 
-    // Interpolate along the x-axis for the bottom row
-    atta::vec3 p1 = q01 * (1.0f - fx) + q11 * fx;
+    const std::array<float, 9>& m = _colorCorrectionMatrix;
+    const bool identityMatrix = m == std::array<float, 9>{1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    if (identityMatrix) {
+        // Channels are independent, use 1D LUTs
+        if (_toneContrast == 0.0f && _transferCurve == TransferCurve::LINEAR)
+            _colorLutMode = ColorLutMode::IDENTITY;
+        else if (_toneContrast == 0.0f && _transferCurve == TransferCurve::SRGB)
+            _colorLutMode = ColorLutMode::CURVE_SRGB;
+        else {
+            _colorLutMode = ColorLutMode::CURVE;
+            for (uint32_t v = 0; v < 256; v++) {
+                uint8_t value = static_cast<uint8_t>(applyToneCurve(v / 255.0f) * 255.0f + 0.5f);
+                for (uint32_t c = 0; c < 3; c++)
+                    _colorCurve[c][v] = value;
+            }
+        }
+        return;
+    }
 
-    // Interpolate along the y-axis between the results of the x-interpolations
-    atta::vec3 result = p0 * (1.0f - fy) + p1 * fy;
+    // Bake the CCM into the 3D LUT and the clamping + transfer curve + tone curve into the output LUT. The nodes are not clamped (16-bit
+    // fixed point over the range of the CCM output), so the LUT holds a linear function that the interpolation reproduces exactly
+    _colorLutMode = ColorLutMode::LUT_3D;
+    _colorLutDim = _colorLutSize;
+    const uint32_t dim = _colorLutDim;
+    float low = 0.0f;
+    float high = 1.0f;
+    for (uint32_t c = 0; c < 3; c++) {
+        float negative = 0.0f;
+        float positive = 0.0f;
+        for (uint32_t k = 0; k < 3; k++)
+            (m[c * 3 + k] < 0.0f ? negative : positive) += m[c * 3 + k];
+        low = std::min(low, negative);
+        high = std::max(high, positive);
+    }
+    const float scale = 65535.0f / (high - low);
+    _colorLut.resize(dim * dim * dim * 3);
+    for (uint32_t b = 0; b < dim; b++) {
+        for (uint32_t g = 0; g < dim; g++) {
+            for (uint32_t r = 0; r < dim; r++) {
+                atta::vec3 in(r / float(dim - 1), g / float(dim - 1), b / float(dim - 1));
+                uint16_t* out = &_colorLut[((b * dim + g) * dim + r) * 3];
+                for (uint32_t c = 0; c < 3; c++) {
+                    float value = m[c * 3] * in.x + m[c * 3 + 1] * in.y + m[c * 3 + 2] * in.z;
+                    out[c] = static_cast<uint16_t>(std::clamp((value - low) * scale + 0.5f, 0.0f, 65535.0f));
+                }
+            }
+        }
+    }
+    _colorLutOutput.resize(65536);
+    for (uint32_t i = 0; i < 65536; i++)
+        _colorLutOutput[i] = static_cast<uint8_t>(applyToneCurve(std::clamp(low + i / scale, 0.0f, 1.0f)) * 255.0f + 0.5f);
+}
+
+bool Project::loadColorLut(const fs::path& path) {
+    std::ifstream file(path);
+    if (!file) {
+        LOG_ERROR("Color correction", "Could not open LUT file [w]$0[]", path.string());
+        return false;
+    }
+
+    // Parse .cube file (LUT_3D_SIZE followed by size^3 RGB lines in [0, 1], red changing fastest)
+    uint32_t dim = 0;
+    TrackedVector<uint16_t> lut;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream ss(line);
+        if (std::isalpha(static_cast<unsigned char>(line[0]))) {
+            std::string keyword;
+            ss >> keyword;
+            if (keyword == "LUT_3D_SIZE") {
+                ss >> dim;
+                lut.reserve(dim * dim * dim * 3);
+            } else if (keyword == "LUT_1D_SIZE") {
+                LOG_ERROR("Color correction", "1D .cube LUTs are not supported");
+                return false;
+            }
+            continue;
+        }
+        float r, g, b;
+        if (ss >> r >> g >> b) {
+            lut.push_back(static_cast<uint16_t>(std::clamp(r, 0.0f, 1.0f) * 65535.0f + 0.5f));
+            lut.push_back(static_cast<uint16_t>(std::clamp(g, 0.0f, 1.0f) * 65535.0f + 0.5f));
+            lut.push_back(static_cast<uint16_t>(std::clamp(b, 0.0f, 1.0f) * 65535.0f + 0.5f));
+        }
+    }
+
+    if (dim < 2 || lut.size() != size_t(dim) * dim * dim * 3) {
+        LOG_ERROR("Color correction", "Invalid LUT file [w]$0[] (size $1, $2 entries)", path.string(), dim, lut.size() / 3);
+        return false;
+    }
+
+    _colorLut = std::move(lut);
+    _colorLutDim = dim;
+    _colorLutOutput.resize(65536);
+    for (uint32_t i = 0; i < 65536; i++)
+        _colorLutOutput[i] = static_cast<uint8_t>(i * (255.0f / 65535.0f) + 0.5f);
+    _colorLutFile = path.string();
+    _colorLutMode = ColorLutMode::LUT_3D;
+    _colorLutDirty = false;
+    LOG_INFO("Color correction", "Loaded $0^3 LUT from [w]$1[]", dim, path.string());
+    return true;
+}
+
+Project::CalibrationProfile Project::correctionProfile(const CameraModule& camera) const {
+    if (camera.useCalibration)
+        return camera.calibration;
+
+    // Ideal profile, same parameters as the degradation pipeline
+    CalibrationProfile profile;
+    profile.vignettingCoeffs = _vignettingCoeffs;
+    profile.colorShading = _colorShadingError;
+    profile.chromaticAberrationCoeffsR = _chromaticAberrationCoeffsR;
+    profile.chromaticAberrationCoeffsB = _chromaticAberrationCoeffsB;
+    return profile;
+}
+
+atta::vec3 Project::radialShadingGain(const CalibrationProfile& profile, float r) {
+    // Vignetting polynomial
+    const std::array<float, 5>& v = profile.vignettingCoeffs;
+    float vignetting = (((v[0] * r + v[1]) * r + v[2]) * r + v[3]) * r + v[4];
+
+    // Color shading gains, interpolated between the closest entries
+    float pos = std::min(r, 1.0f) * (COLOR_SHADING_COUNT - 1);
+    uint32_t idx = std::min(uint32_t(pos), uint32_t(COLOR_SHADING_COUNT - 2));
+    float t = pos - idx;
+    atta::vec3 shading = (1.0f - t) * profile.colorShading[idx] + t * profile.colorShading[idx + 1];
+
+    atta::vec3 gain;
+    for (uint32_t c = 0; c < 3; c++)
+        gain[c] = std::clamp(1.0f / (vignetting * shading[c]), 0.0f, LENS_SHADING_MAX_GAIN);
+    return gain;
+}
+
+void Project::runCalibration() {
+    auto start = std::chrono::steady_clock::now();
+    res::Image* refImg = res::get<res::Image>("reference");
+    uint32_t w = refImg->getWidth();
+    uint32_t h = refImg->getHeight();
+    uint32_t ch = refImg->getChannels();
+    CalibrationProfile profile = correctionProfile();
+
+    // Flat-field capture
+    std::vector<uint8_t> flatScene(size_t(w) * h * ch, FLAT_FIELD_LEVEL);
+    std::vector<uint8_t> flatCapture(size_t(w) * h * ch);
+    captureCalibrationImage(flatScene.data(), flatCapture.data(), w, h, ch);
+    calibrateShading(flatCapture.data(), w, h, ch, profile);
+
+    // Grid chart capture
+    res::Image::CreateInfo info;
+    info.format = res::Image::Format::RGB8;
+    res::Image* gridImg = res::get<res::Image>("calibration_grid");
+    if (gridImg == nullptr) {
+        gridImg = res::create<res::Image>("calibration_grid", info);
+        gridImg->load(fil::getProject()->getResourceRootPaths()[0] / "grid.png");
+    }
+    uint32_t gw = gridImg->getWidth();
+    uint32_t gh = gridImg->getHeight();
+    uint32_t gch = gridImg->getChannels();
+    std::vector<uint8_t> gridCapture(size_t(gw) * gh * gch);
+    captureCalibrationImage(gridImg->getData(), gridCapture.data(), gw, gh, gch);
+    calibrateChromaticAberration(gridCapture.data(), gw, gh, gch, profile);
+
+    _camera.calibration = profile;
+    _camera.useCalibration = true;
+    _calibrationTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("Calibration", "Calibration finished in $0 ms", _calibrationTime);
+    saveCalibrationProfile(fil::getProject()->getResourceRootPaths()[0].parent_path() / "calibration_profile.txt");
+}
+
+void Project::captureCalibrationImage(const uint8_t* sceneData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) {
+    // Run the scene through the simulated camera (degradation pipeline), followed by the corrections that are always done before calibration
+    std::vector<uint8_t> a(sceneData, sceneData + size_t(w) * h * ch);
+    std::vector<uint8_t> b(size_t(w) * h * ch);
+    const Tile frame = fullFrame(w, h);
+    prepareStages(w, h, ch);
+    degWhiteBalanceError(a.data(), b.data(), w, h, ch, frame);
+    degLensDistortion(b.data(), a.data(), w, h, ch, frame);
+    degColorShadingError(a.data(), b.data(), w, h, ch, frame);
+    degChromaticAberrationError(b.data(), a.data(), w, h, ch, frame);
+    degVignettingError(a.data(), b.data(), w, h, ch, frame);
+    degSensorNoise(b.data(), a.data(), w, h, ch, frame);
+    degBlackLevelOffset(a.data(), b.data(), w, h, ch, frame);
+    degDeadPixelInjection(b.data(), a.data(), w, h, ch, frame);
+    proDeadPixelCorrection(a.data(), b.data(), w, h, ch, frame);
+    proBlackLevelCorrection(b.data(), outData, w, h, ch, frame);
+}
+
+void Project::calibrateShading(const uint8_t* flatData, uint32_t w, uint32_t h, uint32_t ch, CalibrationProfile& profile) const {
+    constexpr uint32_t BINS = CALIBRATION_RADIAL_BINS;
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+
+    // Accumulate subsampled pixels in radial bins (sum of each channel and count)
+    std::mutex mutex;
+    std::vector<std::array<double, 4>> bins(BINS, {0.0, 0.0, 0.0, 0.0});
+    parallelFor(h / CALIBRATION_STRIDE, [&](uint32_t begin, uint32_t end) {
+        std::vector<std::array<double, 4>> localBins(BINS, {0.0, 0.0, 0.0, 0.0});
+        for (uint32_t y = begin * CALIBRATION_STRIDE; y < end * CALIBRATION_STRIDE; y += CALIBRATION_STRIDE) {
+            for (uint32_t x = 0; x < w; x += CALIBRATION_STRIDE) {
+                const uint8_t* pixel = &flatData[(size_t(y) * w + x) * ch];
+                // Skip clipped pixels (remaining dead pixels or saturation)
+                if (std::min({pixel[0], pixel[1], pixel[2]}) == 0 || std::max({pixel[0], pixel[1], pixel[2]}) == 255)
+                    continue;
+                float r = (atta::vec2(x, y) - center).length() / center.length();
+                std::array<double, 4>& bin = localBins[std::min(uint32_t(r * BINS), BINS - 1)];
+                for (uint32_t c = 0; c < 3; c++)
+                    bin[c] += pixel[c];
+                bin[3] += 1.0;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t i = 0; i < BINS; i++)
+            for (uint32_t k = 0; k < 4; k++)
+                bins[i][k] += localBins[i][k];
+    });
+
+    // Gain of each bin relative to the center (this also cancels the white balance of the capture)
+    if (bins[0][3] == 0.0) {
+        LOG_WARN("Calibration", "Flat-field center has no valid pixels, skipping shading calibration");
+        return;
+    }
+    std::vector<float> radius, weight;
+    std::vector<atta::vec3> gain;
+    for (uint32_t i = 0; i < BINS; i++) {
+        if (bins[i][3] == 0.0)
+            continue;
+        atta::vec3 g;
+        for (uint32_t c = 0; c < 3; c++)
+            g[c] = float((bins[i][c] / bins[i][3]) / (bins[0][c] / bins[0][3]));
+        radius.push_back((i + 0.5f) / BINS);
+        weight.push_back(float(bins[i][3]));
+        gain.push_back(g);
+    }
+
+    // Fit vignetting polynomial V(r) = a⋅r^4 + b⋅r^3 + c⋅r^2 + d⋅r + e to the channel average (weighted least squares)
+    std::vector<double> ata(25, 0.0), atb(5, 0.0), coeffs;
+    for (size_t i = 0; i < radius.size(); i++) {
+        double r = radius[i];
+        std::array<double, 5> basis = {r * r * r * r, r * r * r, r * r, r, 1.0};
+        double value = (gain[i].x + gain[i].y + gain[i].z) / 3.0;
+        for (uint32_t j = 0; j < 5; j++) {
+            for (uint32_t k = 0; k < 5; k++)
+                ata[j * 5 + k] += weight[i] * basis[j] * basis[k];
+            atb[j] += weight[i] * basis[j] * value;
+        }
+    }
+    if (!solveLinearSystem(ata, atb, 5, coeffs)) {
+        LOG_WARN("Calibration", "Could not fit vignetting polynomial");
+        return;
+    }
+    for (uint32_t j = 0; j < 5; j++)
+        profile.vignettingCoeffs[j] = float(coeffs[j]);
+
+    // Color shading is the per-channel gain that is not explained by the vignetting
+    auto vignetting = [&](float r) {
+        const std::array<float, 5>& v = profile.vignettingCoeffs;
+        return (((v[0] * r + v[1]) * r + v[2]) * r + v[3]) * r + v[4];
+    };
+    for (uint32_t i = 0; i < COLOR_SHADING_COUNT; i++) {
+        float r = float(i) / (COLOR_SHADING_COUNT - 1);
+        // Interpolate bin gains at r
+        size_t j = std::lower_bound(radius.begin(), radius.end(), r) - radius.begin();
+        atta::vec3 g;
+        if (j == 0)
+            g = gain.front();
+        else if (j == radius.size())
+            g = gain.back();
+        else {
+            float t = (r - radius[j - 1]) / (radius[j] - radius[j - 1]);
+            g = (1.0f - t) * gain[j - 1] + t * gain[j];
+        }
+        profile.colorShading[i] = g / vignetting(r);
+    }
+
+    // Lens shading mesh: center level over the average of the flat field in a cell-sized window around each node. Nodes without valid
+    // pixels use the radial profile
+    constexpr uint32_t MW = LENS_SHADING_MESH_W;
+    constexpr uint32_t MH = LENS_SHADING_MESH_H;
+    const uint32_t halfW = std::max(1u, (w - 1) / (MW - 1) / 2);
+    const uint32_t halfH = std::max(1u, (h - 1) / (MH - 1) / 2);
+    profile.lensShading.resize(MW * MH);
+    parallelFor(MW * MH, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t node = begin; node < end; node++) {
+            const uint32_t nx = node % MW * (w - 1) / (MW - 1);
+            const uint32_t ny = node / MW * (h - 1) / (MH - 1);
+            std::array<double, 4> sum = {0.0, 0.0, 0.0, 0.0};
+            for (uint32_t y = ny > halfH ? ny - halfH : 0; y <= std::min(h - 1, ny + halfH); y += CALIBRATION_STRIDE) {
+                for (uint32_t x = nx > halfW ? nx - halfW : 0; x <= std::min(w - 1, nx + halfW); x += CALIBRATION_STRIDE) {
+                    const uint8_t* pixel = &flatData[(size_t(y) * w + x) * ch];
+                    if (std::min({pixel[0], pixel[1], pixel[2]}) == 0 || std::max({pixel[0], pixel[1], pixel[2]}) == 255)
+                        continue;
+                    for (uint32_t c = 0; c < 3; c++)
+                        sum[c] += pixel[c];
+                    sum[3] += 1.0;
+                }
+            }
+            atta::vec3& gain = profile.lensShading[node];
+            if (sum[3] == 0.0) {
+                gain = radialShadingGain(profile, (atta::vec2(nx, ny) - center).length() / center.length());
+                continue;
+            }
+            for (uint32_t c = 0; c < 3; c++)
+                gain[c] = float((bins[0][c] / bins[0][3]) / (sum[c] / sum[3]));
+        }
+    });
+}
+
+void Project::calibrateChromaticAberration(const uint8_t* gridData, uint32_t w, uint32_t h, uint32_t ch, CalibrationProfile& profile) const {
+    constexpr uint32_t TILE = CALIBRATION_TILE;
+    constexpr float MAX_SCALE = 0.05f;   // Largest radial scale searched
+    constexpr float COARSE_STEP = 0.001f;
+    constexpr float FINE_STEP = 0.0001f;
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    const uint32_t tilesX = w / TILE;
+    const uint32_t tilesY = h / TILE;
+
+    // Per-tile measurement: normalized radius, displacement of the red and blue channels, and weight
+    struct TileMeasurement {
+        float r = 0.0f;
+        float displacementR = 0.0f;
+        float displacementB = 0.0f;
+        float weight = 0.0f;
+    };
+    std::vector<TileMeasurement> tiles(tilesX * tilesY);
+
+    parallelFor(tilesX * tilesY, [&](uint32_t begin, uint32_t end) {
+        std::vector<float> green(TILE * TILE);
+        std::vector<float> sampled(TILE * TILE);
+        for (uint32_t t = begin; t < end; t++) {
+            const uint32_t x0 = (t % tilesX) * TILE;
+            const uint32_t y0 = (t / tilesX) * TILE;
+            atta::vec2 tileCenter(x0 + TILE / 2.0f, y0 + TILE / 2.0f);
+            float r = (tileCenter - center).length() / center.length();
+            // The displacement close to the center is too small to be measured
+            if (r < 0.2f)
+                continue;
+
+            // Green channel is the reference. Tiles without edges carry no alignment information
+            float mean = 0.0f;
+            for (uint32_t y = 0; y < TILE; y++)
+                for (uint32_t x = 0; x < TILE; x++)
+                    mean += green[y * TILE + x] = gridData[(size_t(y0 + y) * w + x0 + x) * ch + 1];
+            mean /= TILE * TILE;
+            float variance = 0.0f;
+            for (float& g : green) {
+                g -= mean;
+                variance += g * g;
+            }
+            if (variance / (TILE * TILE) < 100.0f)
+                continue;
+
+            // Normalized cross-correlation between the green tile and the channel sampled with a radial scale
+            auto correlation = [&](uint32_t c, float scale) {
+                float sum = 0.0f;
+                for (uint32_t y = 0; y < TILE; y++) {
+                    for (uint32_t x = 0; x < TILE; x++) {
+                        atta::vec2 delta = atta::vec2(x0 + x, y0 + y) - center;
+                        float sx = center.x + delta.x * (1.0f + scale);
+                        float sy = center.y + delta.y * (1.0f + scale);
+                        sum += sampled[y * TILE + x] = sampleChannel<Interpolation::BILINEAR>(gridData + c, w, h, ch, sx, sy);
+                    }
+                }
+                float sampledMean = sum / (TILE * TILE);
+                float cross = 0.0f;
+                float sampledVariance = 0.0f;
+                for (uint32_t i = 0; i < TILE * TILE; i++) {
+                    float s = sampled[i] - sampledMean;
+                    cross += s * green[i];
+                    sampledVariance += s * s;
+                }
+                return sampledVariance > 0.0f ? cross / std::sqrt(sampledVariance * variance) : -1.0f;
+            };
+
+            // Coarse to fine search of the best scale
+            auto bestScale = [&](uint32_t c) {
+                float best = 0.0f;
+                float bestCorrelation = -2.0f;
+                for (float scale = -MAX_SCALE; scale <= MAX_SCALE; scale += COARSE_STEP) {
+                    float corr = correlation(c, scale);
+                    if (corr > bestCorrelation)
+                        bestCorrelation = corr, best = scale;
+                }
+                float coarse = best;
+                for (float scale = coarse - COARSE_STEP; scale <= coarse + COARSE_STEP; scale += FINE_STEP) {
+                    float corr = correlation(c, scale);
+                    if (corr > bestCorrelation)
+                        bestCorrelation = corr, best = scale;
+                }
+                return best;
+            };
+
+            // The channel sampled at c + (p - c)(1 + s) aligns with green when (1 + s)(1 + C(r)) = 1
+            tiles[t].r = r;
+            tiles[t].displacementR = 1.0f / (1.0f + bestScale(0)) - 1.0f;
+            tiles[t].displacementB = 1.0f / (1.0f + bestScale(2)) - 1.0f;
+            tiles[t].weight = std::sqrt(variance / (TILE * TILE));
+        }
+    });
+
+    // Fit C(r) = a⋅r^2 + b⋅r^3 to the tile displacements (weighted least squares)
+    auto fit = [&](bool red, std::array<float, 2>& coeffs) {
+        std::vector<double> ata(4, 0.0), atb(2, 0.0), x;
+        uint32_t count = 0;
+        for (const TileMeasurement& tile : tiles) {
+            if (tile.weight == 0.0f)
+                continue;
+            double r2 = tile.r * tile.r;
+            std::array<double, 2> basis = {r2, r2 * tile.r};
+            double value = red ? tile.displacementR : tile.displacementB;
+            for (uint32_t j = 0; j < 2; j++) {
+                for (uint32_t k = 0; k < 2; k++)
+                    ata[j * 2 + k] += tile.weight * basis[j] * basis[k];
+                atb[j] += tile.weight * basis[j] * value;
+            }
+            count++;
+        }
+        if (count < 4 || !solveLinearSystem(ata, atb, 2, x)) {
+            LOG_WARN("Calibration", "Not enough grid edges to fit chromatic aberration ($0 tiles)", count);
+            return;
+        }
+        coeffs = {float(x[0]), float(x[1])};
+    };
+    fit(true, profile.chromaticAberrationCoeffsR);
+    fit(false, profile.chromaticAberrationCoeffsB);
+}
+
+bool Project::saveCalibrationProfile(const fs::path& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        LOG_ERROR("Calibration", "Could not write calibration profile to [w]$0[]", path.string());
+        return false;
+    }
+
+    const CalibrationProfile& p = _camera.calibration;
+    file << "vignetting =";
+    for (float v : p.vignettingCoeffs)
+        file << " " << v;
+    file << "\ncolorShading =";
+    for (const atta::vec3& g : p.colorShading)
+        file << " " << g.x << " " << g.y << " " << g.z;
+    file << "\nchromaticAberrationR = " << p.chromaticAberrationCoeffsR[0] << " " << p.chromaticAberrationCoeffsR[1];
+    file << "\nchromaticAberrationB = " << p.chromaticAberrationCoeffsB[0] << " " << p.chromaticAberrationCoeffsB[1] << "\n";
+    if (!p.lensShading.empty()) {
+        file << "lensShading =";
+        for (const atta::vec3& g : p.lensShading)
+            file << " " << g.x << " " << g.y << " " << g.z;
+        file << "\n";
+    }
+    LOG_INFO("Calibration", "Calibration profile written to [w]$0[]", path.string());
+    return true;
+}
+
+bool Project::loadCalibrationProfile(const fs::path& path, CameraModule& camera) const {
+    std::ifstream file(path);
+    if (!file)
+        return false;
+
+    CalibrationProfile p = correctionProfile(camera);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream ss(line);
+        std::string key, equal;
+        ss >> key >> equal;
+        if (key == "vignetting")
+            for (float& v : p.vignettingCoeffs)
+                ss >> v;
+        else if (key == "colorShading")
+            for (atta::vec3& g : p.colorShading)
+                ss >> g.x >> g.y >> g.z;
+        else if (key == "chromaticAberrationR")
+            ss >> p.chromaticAberrationCoeffsR[0] >> p.chromaticAberrationCoeffsR[1];
+        else if (key == "chromaticAberrationB")
+            ss >> p.chromaticAberrationCoeffsB[0] >> p.chromaticAberrationCoeffsB[1];
+        else if (key == "lensShading") {
+            p.lensShading.resize(LENS_SHADING_MESH_W * LENS_SHADING_MESH_H);
+            for (atta::vec3& g : p.lensShading)
+                ss >> g.x >> g.y >> g.z;
+        }
+        if (ss.fail()) {
+            LOG_ERROR("Calibration", "Invalid calibration profile line [w]$0[]", line);
+            return false;
+        }
+    }
+    camera.calibration = p;
+    LOG_INFO("Calibration", "Loaded calibration profile from [w]$0[]", path.string());
+    return true;
+}
+
+bool Project::solveLinearSystem(std::vector<double> a, std::vector<double> b, uint32_t n, std::vector<double>& x) {
+    // Gaussian elimination with partial pivoting
+    for (uint32_t col = 0; col < n; col++) {
+        uint32_t pivot = col;
+        for (uint32_t row = col + 1; row < n; row++)
+            if (std::abs(a[row * n + col]) > std::abs(a[pivot * n + col]))
+                pivot = row;
+        if (std::abs(a[pivot * n + col]) < 1e-12)
+            return false;
+        for (uint32_t k = 0; k < n; k++)
+            std::swap(a[col * n + k], a[pivot * n + k]);
+        std::swap(b[col], b[pivot]);
+
+        for (uint32_t row = col + 1; row < n; row++) {
+            double f = a[row * n + col] / a[col * n + col];
+            for (uint32_t k = col; k < n; k++)
+                a[row * n + k] -= f * a[col * n + k];
+            b[row] -= f * b[col];
+        }
+    }
+
+    x.assign(n, 0.0);
+    for (int row = int(n) - 1; row >= 0; row--) {
+        double sum = b[row];
+        for (uint32_t k = row + 1; k < n; k++)
+            sum -= a[row * n + k] * x[k];
+        x[row] = sum / a[row * n + row];
+    }
+    return true;
+}
+
+std::vector<Project::EquivalenceVariant> Project::equivalenceVariants() {
+    std::vector<EquivalenceVariant> variants;
+
+    // Whole frame in the calling thread
+    variants.push_back({"serial", [this](const Stage& stage, const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) {
+        runSerial([&]() { (this->*stage.func)(inData, outData, w, h, 3, fullFrame(w, h)); });
+    }});
+
+    // Whole frame with parallel loops (the path used by the pipeline)
+    variants.push_back({"threaded", [this](const Stage& stage, const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) {
+        (this->*stage.func)(inData, outData, w, h, 3, fullFrame(w, h));
+    }});
+
+    // Planar frames
+    variants.push_back({"planar", [this](const Stage& stage, const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) {
+        const size_t pixels = size_t(w) * h;
+        std::vector<uint8_t> in(pixels * 3);
+        std::vector<uint8_t> out(pixels * 3);
+        interleavedToPlanar(inData, in.data(), pixels, 3);
+        (this->*stage.func)(in.data(), out.data(), w, h, 3, fullFrame(w, h, true));
+        planarToInterleaved(out.data(), outData, pixels, 3);
+    }});
+
+    // Output tiles processed in parallel, each one reading its tile grown by the halo of the stage (as in out-of-core processing)
+    variants.push_back({"tiled", [this](const Stage& stage, const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) {
+        const uint32_t tilesX = (w + EQUIVALENCE_TILE_SIZE - 1) / EQUIVALENCE_TILE_SIZE;
+        const uint32_t tilesY = (h + EQUIVALENCE_TILE_SIZE - 1) / EQUIVALENCE_TILE_SIZE;
+        parallelFor(tilesX * tilesY, [&](uint32_t begin, uint32_t end) {
+            std::vector<uint8_t> in;
+            std::vector<uint8_t> out;
+            for (uint32_t t = begin; t < end; t++) {
+                Tile tile;
+                tile.out.x = (t % tilesX) * EQUIVALENCE_TILE_SIZE;
+                tile.out.y = (t / tilesX) * EQUIVALENCE_TILE_SIZE;
+                tile.out.w = std::min(EQUIVALENCE_TILE_SIZE, w - tile.out.x);
+                tile.out.h = std::min(EQUIVALENCE_TILE_SIZE, h - tile.out.y);
+                tile.in = growRegion(tile.out, stage.halo ? (this->*stage.halo)(tile.out, w, h) : 0, w, h);
+                in.resize(size_t(tile.in.w) * tile.in.h * 3);
+                out.resize(size_t(tile.out.w) * tile.out.h * 3);
+                for (uint32_t y = tile.in.y; y < tile.in.y + tile.in.h; y++)
+                    std::memcpy(&in[tile.inIndex(tile.in.x, y, 3)], &inData[(size_t(y) * w + tile.in.x) * 3], tile.in.w * 3);
+                (this->*stage.func)(in.data(), out.data(), w, h, 3, tile);
+                for (uint32_t y = tile.out.y; y < tile.out.y + tile.out.h; y++)
+                    std::memcpy(&outData[(size_t(y) * w + tile.out.x) * 3], &out[tile.outIndex(tile.out.x, y, 3)], tile.out.w * 3);
+            }
+        });
+    }});
+
+    // RGBA frames with a varying alpha channel, whose color channels have to match the RGB frames
+    variants.push_back({"rgba", [this](const Stage& stage, const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) {
+        const size_t pixels = size_t(w) * h;
+        std::vector<uint8_t> in(pixels * 4);
+        std::vector<uint8_t> out(pixels * 4);
+        imageToFrame(inData, 3, in.data(), 4, pixels, false);
+        for (size_t i = 0; i < pixels; i++)
+            in[i * 4 + 3] = uint8_t(randomHash(0, uint32_t(i)));
+        generateDeadPixels(_camera, w, h, 4);
+        (this->*stage.func)(in.data(), out.data(), w, h, 4, fullFrame(w, h));
+        generateDeadPixels(_camera, w, h, 3);
+        frameToImage(out.data(), 4, false, outData, 3, pixels);
+    }});
+
+    return variants;
+}
+
+std::vector<Project::ReferenceStage> Project::referenceStages() {
+    // Same order as the pipeline. The lens shading mesh interpolates the gains between the mesh nodes (and steps them in fixed point), and the
+    // color LUTs interpolate the color transform between the LUT nodes, so these stages get the error of the approximation as tolerance
+    return {
+        {"deg_white_balance", &Project::refDegWhiteBalanceError},
+        {"deg_lens", &Project::refDegLensDistortion},
+        {"deg_color_shading", &Project::refDegColorShadingError},
+        {"deg_chromatic_aberration", &Project::refDegChromaticAberrationError},
+        {"deg_vignetting", &Project::refDegVignettingError},
+        {"deg_sensor_noise", &Project::refDegSensorNoise},
+        {"deg_black_level", &Project::refDegBlackLevelOffset},
+        {"deg_dead_pixel", &Project::refDegDeadPixelInjection},
+        {"deg_output", &Project::refCopy},
+        {"pro_dead_pixel", &Project::refProDeadPixelCorrection},
+        {"pro_black_level", &Project::refProBlackLevelCorrection},
+        {"pro_noise_reduction", &Project::refProNoiseReduction},
+        {"pro_lens_shading", &Project::refProLensShadingCorrection, LENS_SHADING_TOLERANCE, LENS_SHADING_MEAN_TOLERANCE},
+        {"pro_chromatic_aberration", &Project::refProChromaticAberrationCorrection},
+        {"pro_lens", &Project::refProLensCorrection},
+        {"pro_white_balance", &Project::refProWhiteBalanceCorrection},
+        {"pro_color", &Project::refProColorCorrection, COLOR_LUT_TOLERANCE, COLOR_LUT_MEAN_TOLERANCE},
+        {"pro_output", &Project::refCopy},
+    };
+}
+
+void Project::runEquivalenceHarness() {
+    auto start = std::chrono::steady_clock::now();
+    struct Input {
+        std::string name;
+        uint32_t w;
+        uint32_t h;
+        std::vector<uint8_t> data; // RGB
+        bool chained = true;       // Each stage reads the reference output of the previous stage, or the input itself
+    };
+    std::vector<Input> inputs;
+
+    // Synthetic images
+    for (uint32_t i = 0; i < EQUIVALENCE_SYNTHETIC_SIZES.size(); i++) {
+        const auto [w, h] = EQUIVALENCE_SYNTHETIC_SIZES[i];
+        Input input{"synthetic_" + std::to_string(w) + "x" + std::to_string(h), w, h, std::vector<uint8_t>(size_t(w) * h * 3)};
+        generateSyntheticImage(i, w, h, input.data.data());
+        inputs.push_back(std::move(input));
+    }
+
+    // Golden checksums of the integer stages in the reference pipeline and in the stage pipeline, run with the default parameters so they do
+    // not depend on the UI state. Only the synthetic images are used, so they do not depend on the image decoder either, and each stage reads
+    // the image itself, so they do not depend on the floating point stages before it
+    const std::vector<ReferenceStage> references = referenceStages();
+    auto golden = [](const std::string& name) { return std::find(GOLDEN_STAGES.begin(), GOLDEN_STAGES.end(), name) != GOLDEN_STAGES.end(); };
+    std::unique_ptr<Project> defaults = std::make_unique<Project>();
+    defaults->_stages = _stages;
+    std::vector<std::pair<std::string, uint64_t>> checksums;
+    for (const Input& input : inputs) {
+        std::vector<std::vector<uint8_t>> outputs = defaults->runReferencePipeline(input.data.data(), input.w, input.h, false);
+        for (size_t r = 0; r < references.size(); r++)
+            if (golden(references[r].name))
+                checksums.emplace_back("reference " + input.name + " " + references[r].name, hashData(outputs[r].data(), outputs[r].size()));
+        outputs = defaults->runStagePipeline(input.data.data(), input.w, input.h, false);
+        for (size_t s = 0; s < _stages.size(); s++)
+            if (golden(_stages[s].name))
+                checksums.emplace_back("pipeline " + input.name + " " + _stages[s].name, hashData(outputs[s].data(), outputs[s].size()));
+    }
+    const fs::path resourcePath = fil::getProject()->getResourceRootPaths()[0];
+    _goldenMismatches = checkGoldenChecksums(checksums, resourcePath.parent_path() / "golden_checksums.txt", _updateGoldenChecksums);
+
+    // Bundled images, downscaled so the harness runs in a few seconds
+    res::Image::CreateInfo info;
+    info.format = res::Image::Format::RGB8;
+    res::Image* img = res::get<res::Image>("equivalence_input");
+    if (img == nullptr)
+        img = res::create<res::Image>("equivalence_input", info);
+    for (const std::string& name : _testImages) {
+        const std::string extension = fs::path(name).extension().string();
+        if (extension != ".png" && extension != ".jpg")
+            continue; // Frame files (PPM, Y4M, raw) are read by the input panel
+        img->load(resourcePath / name);
+        const uint32_t iw = img->getWidth();
+        const uint32_t ih = img->getHeight();
+        std::vector<uint8_t> rgb(size_t(iw) * ih * 3);
+        imageToFrame(img->getData(), img->getChannels(), rgb.data(), 3, size_t(iw) * ih, false);
+        const float scale = std::min(1.0f, float(EQUIVALENCE_MAX_SIZE) / std::max(iw, ih));
+        Input input{name, std::max(1u, uint32_t(iw * scale)), std::max(1u, uint32_t(ih * scale)), {}};
+        input.data.resize(size_t(input.w) * input.h * 3);
+        downscaleImage(rgb.data(), iw, ih, input.data.data(), input.w, input.h, 3);
+        inputs.push_back(std::move(input));
+    }
+
+    // Every 8-bit value in every channel (each row shifts the channels differently), given as input to every stage. The chained inputs do not
+    // reach every value of the later stages (e.g. values below the black level offset), and this one checks the LUT stages on their whole
+    // table
+    Input ramp{"ramp_256x16", 256, 16, std::vector<uint8_t>(256 * 16 * 3), false};
+    for (uint32_t y = 0; y < ramp.h; y++)
+        for (uint32_t x = 0; x < ramp.w; x++)
+            for (uint32_t c = 0; c < 3; c++)
+                ramp.data[(y * ramp.w + x) * 3 + c] = uint8_t(x + c * (y * 37 + 85));
+    inputs.push_back(std::move(ramp));
+
+    // Reference of each stage (stages without a reference fail)
+    std::vector<size_t> stageReference(_stages.size(), references.size());
+    for (size_t s = 0; s < _stages.size(); s++) {
+        auto it = std::find_if(references.begin(), references.end(), [&](const ReferenceStage& r) { return r.name == _stages[s].name; });
+        stageReference[s] = size_t(it - references.begin());
+        if (it == references.end())
+            LOG_ERROR("Equivalence", "Stage [w]$0[] has no reference implementation", _stages[s].name);
+    }
+
+    // Compare every variant stage with the reference stage, both reading the reference input of the stage
+    const std::vector<EquivalenceVariant> variants = equivalenceVariants();
+    _equivalenceResults.clear();
+    for (const EquivalenceVariant& variant : variants)
+        for (size_t s = 0; s < _stages.size(); s++) {
+            EquivalenceResult& result = _equivalenceResults.emplace_back();
+            result.variant = variant.name;
+            result.stage = _stages[s].name;
+            result.passed = stageReference[s] < references.size();
+        }
+    for (const Input& input : inputs) {
+        const std::vector<std::vector<uint8_t>> reference = runReferencePipeline(input.data.data(), input.w, input.h, input.chained);
+        prepareStages(input.w, input.h, 3);
+        std::vector<uint8_t> outData(input.data.size());
+        for (size_t v = 0; v < variants.size(); v++) {
+            for (size_t s = 0; s < _stages.size(); s++) {
+                const size_t r = stageReference[s];
+                if (r == references.size())
+                    continue;
+                const uint8_t* inData = r == 0 || !input.chained ? input.data.data() : reference[r - 1].data();
+                variants[v].run(_stages[s], inData, outData.data(), input.w, input.h);
+                uint32_t maxDiff = 0;
+                uint64_t sumDiff = 0;
+                for (size_t i = 0; i < outData.size(); i++) {
+                    const uint32_t diff = std::abs(int(outData[i]) - int(reference[r][i]));
+                    maxDiff = std::max(maxDiff, diff);
+                    sumDiff += diff;
+                }
+                const float meanDiff = float(sumDiff) / outData.size();
+
+                EquivalenceResult& result = _equivalenceResults[v * _stages.size() + s];
+                if (result.input.empty() || maxDiff > result.maxDiff)
+                    result.input = input.name;
+                result.maxDiff = std::max(result.maxDiff, maxDiff);
+                result.meanDiff = std::max(result.meanDiff, meanDiff);
+                result.passed = result.maxDiff <= references[r].maxTolerance && result.meanDiff <= references[r].meanTolerance;
+            }
+        }
+    }
+
+    uint32_t passed = 0;
+    for (const EquivalenceResult& result : _equivalenceResults) {
+        if (result.passed)
+            passed++;
+        else
+            LOG_ERROR("Equivalence", "[w]$0[] $1: max difference $2, mean difference $3 on [w]$4[]", result.variant, result.stage, result.maxDiff,
+                      result.meanDiff, result.input);
+    }
+    _verifyTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("Equivalence", "$0/$1 stage checks passed on $2 inputs, $3 golden checksum mismatches ($4 ms)", passed, _equivalenceResults.size(),
+             inputs.size(), _goldenMismatches, _verifyTime);
+}
+
+std::vector<std::vector<uint8_t>> Project::runReferencePipeline(const uint8_t* inData, uint32_t w, uint32_t h, bool chained) {
+    const std::vector<ReferenceStage> references = referenceStages();
+    std::vector<std::vector<uint8_t>> outputs(references.size(), std::vector<uint8_t>(size_t(w) * h * 3));
+    generateObPixels(_camera); // Measurement read by the black level correction
+    for (size_t r = 0; r < references.size(); r++)
+        (this->*references[r].func)(r == 0 || !chained ? inData : outputs[r - 1].data(), outputs[r].data(), w, h);
+    return outputs;
+}
+
+std::vector<std::vector<uint8_t>> Project::runStagePipeline(const uint8_t* inData, uint32_t w, uint32_t h, bool chained) {
+    std::vector<std::vector<uint8_t>> outputs(_stages.size(), std::vector<uint8_t>(size_t(w) * h * 3));
+    prepareStages(w, h, 3);
+    for (size_t s = 0; s < _stages.size(); s++)
+        (this->*_stages[s].func)(s == 0 || !chained ? inData : outputs[s - 1].data(), outputs[s].data(), w, h, 3, fullFrame(w, h));
+    return outputs;
+}
+
+uint32_t Project::checkGoldenChecksums(const std::vector<std::pair<std::string, uint64_t>>& checksums, const fs::path& path, bool update) const {
+    if (update) {
+        std::ofstream file(path);
+        if (!file) {
+            LOG_ERROR("Equivalence", "Could not write golden checksums to [w]$0[]", path.string());
+            return uint32_t(checksums.size());
+        }
+        file << "# Integer stage output checksums of the reference pipeline and of the stage pipeline (default parameters, synthetic images)\n";
+        for (const auto& [key, hash] : checksums)
+            file << key << " " << std::hex << std::setw(16) << std::setfill('0') << hash << std::dec << "\n";
+        LOG_INFO("Equivalence", "Golden checksums written to [w]$0[]", path.string());
+        return 0;
+    }
+
+    // The checksums are part of the repository, a missing file is an error (every checksum is reported as a mismatch)
+    std::ifstream file(path);
+    if (!file) {
+        LOG_ERROR("Equivalence", "Could not read golden checksums from [w]$0[]", path.string());
+        return uint32_t(checksums.size());
+    }
+    std::map<std::string, uint64_t> golden;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream ss(line);
+        std::string pipeline, input, stage;
+        uint64_t hash;
+        if (!line.empty() && line[0] != '#' && ss >> pipeline >> input >> stage >> std::hex >> hash)
+            golden[pipeline + " " + input + " " + stage] = hash;
+    }
+    uint32_t mismatches = 0;
+    for (const auto& [key, hash] : checksums) {
+        auto it = golden.find(key);
+        if (it == golden.end() || it->second != hash) {
+            LOG_ERROR("Equivalence", "Golden checksum mismatch for [w]$0[]", key);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+void Project::generateSyntheticImage(uint32_t seed, uint32_t w, uint32_t h, uint8_t* outData) {
+    // Blocks of uniform noise, gradients, hard edges, saturated primaries and low-contrast noise, so the stages see flat areas, edges and
+    // clipped values. The block size is not a power of two, so blocks are not aligned with tiles and grid cells
+    constexpr uint32_t BLOCK_W = 19;
+    constexpr uint32_t BLOCK_H = 23;
+    const uint32_t key = randomHash(seed, 0);
+    const uint32_t blocksX = (w + BLOCK_W - 1) / BLOCK_W;
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            const uint32_t block = (y / BLOCK_H) * blocksX + x / BLOCK_W;
+            const uint32_t pattern = randomHash(key, block) % 5;
+            for (uint32_t c = 0; c < 3; c++) {
+                const uint32_t r = randomHash(key + 1, uint32_t((size_t(y) * w + x) * 3 + c));
+                uint32_t value = 0;
+                if (pattern == 0)
+                    value = r & 255; // Uniform noise
+                else if (pattern == 1)
+                    value = std::min(255u, (x * 255 / w + y * 255 / h) / 2 + c * 40); // Gradient
+                else if (pattern == 2)
+                    value = (x / 4 + y / 4) % 2 ? 230 : 25; // Edges
+                else if (pattern == 3)
+                    value = randomHash(key + 2, block * 3 + c) & 1 ? 255 : 0; // Saturated
+                else
+                    value = 124 + (r & 7); // Low-contrast noise
+                outData[(size_t(y) * w + x) * 3 + c] = uint8_t(value);
+            }
+        }
+    }
+}
+
+void Project::refDegWhiteBalanceError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    const atta::vec3 gains = tempToGain(_colorTemperature);
+    for (size_t i = 0; i < size_t(w) * h; i++) {
+        // Apply the temperature gain to each channel
+        for (uint32_t c = 0; c < 3; c++)
+            outData[i * 3 + c] = static_cast<uint8_t>(std::clamp(inData[i * 3 + c] * gains[c], 0.0f, 255.0f));
+    }
+}
+
+void Project::refDegLensDistortion(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            size_t idx = (size_t(y) * w + x) * 3;
+
+            // Compute normalized radial distance
+            atta::vec2 delta = atta::vec2(x, y) - center;
+            float r = delta.length() / center.length();
+            float r2 = r * r;
+            float r4 = r2 * r2;
+
+            // Compute barrel distortion polynomial (source radius)
+            float lensR = r * (_barrelDistortionCoeffs[0] + _barrelDistortionCoeffs[1] * r2 + _barrelDistortionCoeffs[2] * r4);
+
+            // Compute angle
+            float angle = 0.0f;
+            if (delta.squareLength() > 1e-5f)
+                angle = std::atan2(delta.y, delta.x); // Avoid division by zero at the exact center
+
+            // Compute source pixel coordinates
+            float xDist = center.x + lensR * std::cos(angle) * center.length();
+            float yDist = center.y + lensR * std::sin(angle) * center.length();
+
+            // Sample distorted coordinate in source image
+            atta::vec3 pixel = refSampling(inData, w, h, xDist, yDist);
+            outData[idx + 0] = static_cast<uint8_t>(pixel.x);
+            outData[idx + 1] = static_cast<uint8_t>(pixel.y);
+            outData[idx + 2] = static_cast<uint8_t>(pixel.z);
+        }
+    }
+}
+
+void Project::refDegColorShadingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            size_t idx = (size_t(y) * w + x) * 3;
+
+            // Compute normalized radial distance
+            float r = (atta::vec2(x, y) - center).length() / center.length();
+
+            // Compute color shading indices
+            uint32_t gainIdx1 = static_cast<uint32_t>(r * (COLOR_SHADING_COUNT - 1));
+            uint32_t gainIdx2 = gainIdx1 + 1;
+            if (gainIdx2 >= COLOR_SHADING_COUNT)
+                gainIdx2 = COLOR_SHADING_COUNT - 1;
+
+            // Interpolate gain
+            float t = r * (COLOR_SHADING_COUNT - 1) - static_cast<float>(gainIdx1);
+            const atta::vec3& gain1 = _colorShadingError[gainIdx1];
+            const atta::vec3& gain2 = _colorShadingError[gainIdx2];
+            atta::vec3 gain = (1.0f - t) * gain1 + t * gain2;
+
+            const uint8_t* inPix = &inData[idx];
+            atta::vec3 pixel(inPix[0], inPix[1], inPix[2]);
+            atta::vec3 shadedPixel = pixel * gain;
+
+            // Save shaded pixel
+            outData[idx] = static_cast<uint8_t>(std::clamp(shadedPixel.x, 0.0f, 255.0f));
+            outData[idx + 1] = static_cast<uint8_t>(std::clamp(shadedPixel.y, 0.0f, 255.0f));
+            outData[idx + 2] = static_cast<uint8_t>(std::clamp(shadedPixel.z, 0.0f, 255.0f));
+        }
+    }
+}
+
+void Project::refDegChromaticAberrationError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            size_t idx = (size_t(y) * w + x) * 3;
+            // Compute normalized radial distance
+            atta::vec2 delta = atta::vec2(x, y) - center;
+            float r = delta.length() / center.length();
+            float r2 = r * r;
+            float r3 = r2 * r;
+
+            // Calculate chromatic aberration displacement for Red channel
+            float displacementR = (_chromaticAberrationCoeffsR[0] * r2 + _chromaticAberrationCoeffsR[1] * r3);
+            float sxR_float = center.x + delta.x * (1.0f + displacementR);
+            float syR_float = center.y + delta.y * (1.0f + displacementR);
+
+            // Calculate chromatic aberration displacement for Blue channel
+            float displacementB = (_chromaticAberrationCoeffsB[0] * r2 + _chromaticAberrationCoeffsB[1] * r3);
+            float sxB_float = center.x + delta.x * (1.0f + displacementB);
+            float syB_float = center.y + delta.y * (1.0f + displacementB);
+
+            // Sample the displaced channels
+            outData[idx + 0] = (uint8_t)refSampling(inData, w, h, sxR_float, syR_float).x;
+            outData[idx + 1] = inData[idx + 1];
+            outData[idx + 2] = (uint8_t)refSampling(inData, w, h, sxB_float, syB_float).z;
+        }
+    }
+}
+
+void Project::refDegVignettingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            size_t idx = (size_t(y) * w + x) * 3;
+
+            // Compute normalized radial distance
+            float r = (atta::vec2(x, y) - center).length() / center.length();
+            float r2 = r * r;
+            float r3 = r2 * r;
+            float r4 = r2 * r2;
+
+            // Compute vignetting polynomial
+            float vignetting =
+                _vignettingCoeffs[0] * r4 + _vignettingCoeffs[1] * r3 + _vignettingCoeffs[2] * r2 + _vignettingCoeffs[3] * r + _vignettingCoeffs[4];
+
+            // Apply vignetting to the pixel
+            outData[idx] = static_cast<uint8_t>(std::clamp(inData[idx] * vignetting, 0.0f, 255.0f));
+            outData[idx + 1] = static_cast<uint8_t>(std::clamp(inData[idx + 1] * vignetting, 0.0f, 255.0f));
+            outData[idx + 2] = static_cast<uint8_t>(std::clamp(inData[idx + 2] * vignetting, 0.0f, 255.0f));
+        }
+    }
+}
+
+void Project::refDegSensorNoise(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    // Poisson-Gaussian noise with variance a * value + b^2. The random numbers of each row use their own key, indexed by the value in the row
+    const float readVariance = _readNoise * _readNoise;
+    const uint32_t key = randomHash(uint32_t(_sensorNoiseSeed), 0);
+    for (uint32_t y = 0; y < h; y++) {
+        const uint32_t rowKey = randomHash(key, y);
+        for (uint32_t i = 0; i < w * 3; i++) {
+            const size_t idx = size_t(y) * w * 3 + i;
+            float value = inData[idx];
+            float sigma = std::sqrt(_shotNoiseGain * value + readVariance);
+            float noisy = value + sigma * randomNormal(rowKey, i);
+            outData[idx] = static_cast<uint8_t>(std::clamp(noisy + 0.5f, 0.0f, 255.0f));
+        }
+    }
+}
+
+void Project::refDegBlackLevelOffset(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    // Apply black level offset
+    for (size_t i = 0; i < size_t(w) * h * 3; i++) {
+        if (uint32_t(inData[i]) + _blackLevelOffset >= 255)
+            outData[i] = 255;
+        else
+            outData[i] = inData[i] + _blackLevelOffset;
+    }
+}
+
+void Project::refDegDeadPixelInjection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    // Dead pixel injection (set failed photosites to 0)
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t i = 0; i < w * 3; i++) {
+            const size_t idx = size_t(y) * w * 3 + i;
+            outData[idx] = refIsDeadPixel(y, i) ? 0 : inData[idx];
+        }
+    }
+}
+
+void Project::refProDeadPixelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t i = 0; i < w * 3; i++) {
+            const size_t idx = size_t(y) * w * 3 + i;
+            outData[idx] = inData[idx];
+            if (!refIsDeadPixel(y, i))
+                continue;
+
+            // Average of the 4 neighbors inside the frame (same channel)
+            const uint32_t x = i / 3;
+            uint32_t sum = 0;
+            uint32_t count = 0;
+            if (x > 0) {
+                sum += inData[idx - 3];
+                count++;
+            }
+            if (x + 1 < w) {
+                sum += inData[idx + 3];
+                count++;
+            }
+            if (y > 0) {
+                sum += inData[idx - size_t(w) * 3];
+                count++;
+            }
+            if (y + 1 < h) {
+                sum += inData[idx + size_t(w) * 3];
+                count++;
+            }
+            outData[idx] = sum / count;
+        }
+    }
+}
+
+void Project::refProBlackLevelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    // Compute black level from optical black pixels
+    uint32_t blackLevelSum = 0;
+    const std::array<atta::vec3, 10>& obPixels = camera().obPixels;
+    for (size_t i = 0; i < obPixels.size(); i++) {
+        // Get the optical black pixel value
+        const atta::vec3& obPixel = obPixels[i];
+        // Sum channel values
+        blackLevelSum += static_cast<uint32_t>(obPixel.x + obPixel.y + obPixel.z);
+    }
+    uint8_t blackLevel = blackLevelSum / (3 * obPixels.size());
+
+    // Black level correction
+    for (size_t i = 0; i < size_t(w) * h * 3; i++) {
+        if (inData[i] >= blackLevel)
+            outData[i] = inData[i] - blackLevel;
+        else
+            outData[i] = 0;
+    }
+}
+
+void Project::refProNoiseReduction(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    switch (_noiseReductionMode) {
+        case NoiseReductionMode::NONE:
+            refCopy(inData, outData, w, h);
+            break;
+        case NoiseReductionMode::BILATERAL_GRID:
+            refBilateralGridDenoise(inData, outData, w, h);
+            break;
+        case NoiseReductionMode::NON_LOCAL_MEANS:
+            refNonLocalMeansDenoise(inData, outData, w, h);
+            break;
+    }
+}
+
+void Project::refBilateralGridDenoise(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    // Grid sampling rates (pixels per cell and intensity levels per cell)
+    const float spatialSampling = float(std::max(2, 16 / _noiseReductionQuality));
+    const float rangeSampling = std::max(1.0f, _noiseReductionStrength);
+
+    // Grid with one cell of padding on each side. Each cell stores the sum of each channel followed by the weight
+    const uint32_t gw = uint32_t((w - 1) / spatialSampling + 0.5f) + 3;
+    const uint32_t gh = uint32_t((h - 1) / spatialSampling + 0.5f) + 3;
+    const uint32_t gd = uint32_t(255.0f / rangeSampling + 0.5f) + 3;
+    auto cellIndex = [&](uint32_t gx, uint32_t gy, uint32_t gz) { return ((size_t(gy) * gw + gx) * gd + gz) * 4; };
+    std::vector<float> grid(size_t(gw) * gh * gd * 4, 0.0f);
+
+    // The intensity axis is indexed by the channel average
+    auto guide = [](const uint8_t* pixel) { return float(pixel[0] + pixel[1] + pixel[2]) / 3; };
+
+    // Splat
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            const uint8_t* pixel = &inData[(size_t(y) * w + x) * 3];
+            uint32_t gx = uint32_t(x / spatialSampling + 0.5f) + 1;
+            uint32_t gy = uint32_t(y / spatialSampling + 0.5f) + 1;
+            uint32_t gz = uint32_t(guide(pixel) / rangeSampling + 0.5f) + 1;
+            float* cell = &grid[cellIndex(gx, gy, gz)];
+            for (uint32_t c = 0; c < 3; c++)
+                cell[c] += pixel[c];
+            cell[3] += 1.0f;
+        }
+    }
+
+    // Blur with a [1 2 1] kernel along the intensity axis, then x, then y (the border cells are not changed)
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        const std::vector<float> source = grid;
+        for (uint32_t gy = 0; gy < gh; gy++) {
+            for (uint32_t gx = 0; gx < gw; gx++) {
+                for (uint32_t gz = 0; gz < gd; gz++) {
+                    const uint32_t i = axis == 0 ? gz : axis == 1 ? gx : gy;
+                    const uint32_t n = axis == 0 ? gd : axis == 1 ? gw : gh;
+                    if (i == 0 || i + 1 == n)
+                        continue;
+                    const size_t prev = axis == 0 ? cellIndex(gx, gy, gz - 1) : axis == 1 ? cellIndex(gx - 1, gy, gz) : cellIndex(gx, gy - 1, gz);
+                    const size_t next = axis == 0 ? cellIndex(gx, gy, gz + 1) : axis == 1 ? cellIndex(gx + 1, gy, gz) : cellIndex(gx, gy + 1, gz);
+                    const size_t cell = cellIndex(gx, gy, gz);
+                    for (uint32_t k = 0; k < 4; k++)
+                        grid[cell + k] = (source[prev + k] + 2.0f * source[cell + k] + source[next + k]) * 0.25f;
+                }
+            }
+        }
+    }
+
+    // Slice with trilinear interpolation
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            const uint8_t* pixel = &inData[(size_t(y) * w + x) * 3];
+            float fx = x / spatialSampling + 1.0f;
+            float fy = y / spatialSampling + 1.0f;
+            float fz = guide(pixel) / rangeSampling + 1.0f;
+            uint32_t x0 = uint32_t(fx);
+            uint32_t y0 = uint32_t(fy);
+            uint32_t z0 = uint32_t(fz);
+            float tx = fx - x0;
+            float ty = fy - y0;
+            float tz = fz - z0;
+
+            std::array<float, 4> value = {};
+            for (uint32_t corner = 0; corner < 8; corner++) {
+                uint32_t dx = corner & 1;
+                uint32_t dy = (corner >> 1) & 1;
+                uint32_t dz = (corner >> 2) & 1;
+                float weight = (dx ? tx : 1.0f - tx) * (dy ? ty : 1.0f - ty) * (dz ? tz : 1.0f - tz);
+                const float* cell = &grid[cellIndex(x0 + dx, y0 + dy, z0 + dz)];
+                for (uint32_t k = 0; k < 4; k++)
+                    value[k] += weight * cell[k];
+            }
+            uint8_t* outPixel = &outData[(size_t(y) * w + x) * 3];
+            for (uint32_t c = 0; c < 3; c++)
+                outPixel[c] = value[3] > 1e-5f ? static_cast<uint8_t>(std::clamp(value[c] / value[3] + 0.5f, 0.0f, 255.0f)) : pixel[c];
+        }
+    }
+}
+
+void Project::refNonLocalMeansDenoise(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    const int searchRadius = _noiseReductionQuality + 1;
+    const int patchRadius = _noiseReductionQuality >= 3 ? 2 : 1;
+    const int patchSize = 2 * patchRadius + 1;
+
+    // Weight of a patch distance (sum of the squared differences), quantized to 1024 levels of the mean squared difference d, with
+    // weight = exp(-d / h^2) and zero weight for d above 4h^2
+    constexpr uint32_t WEIGHT_LEVELS = 1024;
+    const float h2 = _noiseReductionStrength * _noiseReductionStrength;
+    const float maxDist = 4.0f * h2;
+    const float distToIndex = (WEIGHT_LEVELS - 1) / (maxDist * patchSize * patchSize * 3u);
+    auto patchWeight = [&](uint32_t dist) {
+        uint32_t index = std::min(uint32_t(dist * distToIndex), WEIGHT_LEVELS - 1);
+        return index == WEIGHT_LEVELS - 1 ? 0.0f : std::exp(-(index * maxDist / (WEIGHT_LEVELS - 1)) / h2);
+    };
+
+    // Pixel values with the coordinates clamped to the frame
+    auto value = [&](int x, int y, uint32_t c) { return inData[(size_t(std::clamp(y, 0, int(h) - 1)) * w + std::clamp(x, 0, int(w) - 1)) * 3 + c]; };
+
+    for (int y = 0; y < int(h); y++) {
+        for (int x = 0; x < int(w); x++) {
+            float sumWeight = 0.0f;
+            float maxWeight = 0.0f;
+            std::array<float, 3> sumValue = {};
+            for (int dy = -searchRadius; dy <= searchRadius; dy++) {
+                for (int dx = -searchRadius; dx <= searchRadius; dx++) {
+                    if (dx == 0 && dy == 0)
+                        continue;
+
+                    // Distance between the patch of the pixel and the patch of the neighbor, the neighbor patch is the pixel patch (with clamped
+                    // coordinates) shifted by (dx, dy)
+                    uint32_t dist = 0;
+                    for (int py = -patchRadius; py <= patchRadius; py++) {
+                        for (int px = -patchRadius; px <= patchRadius; px++) {
+                            const int cx = std::clamp(x + px, 0, int(w) - 1);
+                            const int cy = std::clamp(y + py, 0, int(h) - 1);
+                            for (uint32_t c = 0; c < 3; c++) {
+                                const int d = int(value(cx, cy, c)) - int(value(cx + dx, cy + dy, c));
+                                dist += uint32_t(d * d);
+                            }
+                        }
+                    }
+
+                    float weight = patchWeight(dist);
+                    sumWeight += weight;
+                    maxWeight = std::max(maxWeight, weight);
+                    for (uint32_t c = 0; c < 3; c++)
+                        sumValue[c] += weight * value(x + dx, y + dy, c);
+                }
+            }
+
+            // The center pixel gets the largest weight of its neighbors, otherwise it would always dominate the average
+            float selfWeight = maxWeight > 0.0f ? maxWeight : 1.0f;
+            float norm = 1.0f / (sumWeight + selfWeight);
+            for (uint32_t c = 0; c < 3; c++)
+                outData[(size_t(y) * w + x) * 3 + c] =
+                    static_cast<uint8_t>(std::clamp((sumValue[c] + selfWeight * value(x, y, c)) * norm + 0.5f, 0.0f, 255.0f));
+        }
+    }
+}
+
+void Project::refProLensShadingCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    // The correction gains are defined on a mesh of MW x MH nodes, spread evenly over the pixel columns and rows (integer positions), and are
+    // interpolated bilinearly between the nodes
+    constexpr uint32_t MW = LENS_SHADING_MESH_W;
+    constexpr uint32_t MH = LENS_SHADING_MESH_H;
+    const CalibrationProfile profile = correctionProfile();
+    const bool measured = profile.lensShading.size() == MW * MH;
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    std::array<uint32_t, MW> nodeX;
+    std::array<uint32_t, MH> nodeY;
+    for (uint32_t i = 0; i < MW; i++)
+        nodeX[i] = i * (w - 1) / (MW - 1);
+    for (uint32_t j = 0; j < MH; j++)
+        nodeY[j] = j * (h - 1) / (MH - 1);
+
+    // Gain of a node: measured, or the inverse of the vignetting polynomial and of the color shading gains at the node
+    auto nodeGain = [&](uint32_t i, uint32_t j) {
+        if (measured) {
+            atta::vec3 gain = profile.lensShading[j * MW + i];
+            for (uint32_t c = 0; c < 3; c++)
+                gain[c] = std::clamp(gain[c], 0.0f, LENS_SHADING_MAX_GAIN);
+            return gain;
+        }
+        float r = (atta::vec2(nodeX[i], nodeY[j]) - center).length() / center.length();
+        float r2 = r * r;
+        float r3 = r2 * r;
+        float r4 = r2 * r2;
+        const std::array<float, 5>& v = profile.vignettingCoeffs;
+        float vignetting = v[0] * r4 + v[1] * r3 + v[2] * r2 + v[3] * r + v[4];
+
+        uint32_t gainIdx1 = std::min(static_cast<uint32_t>(r * (COLOR_SHADING_COUNT - 1)), uint32_t(COLOR_SHADING_COUNT - 1));
+        uint32_t gainIdx2 = std::min(gainIdx1 + 1, uint32_t(COLOR_SHADING_COUNT - 1));
+        float t = std::min(r, 1.0f) * (COLOR_SHADING_COUNT - 1) - static_cast<float>(gainIdx1);
+        atta::vec3 shading = (1.0f - t) * profile.colorShading[gainIdx1] + t * profile.colorShading[gainIdx2];
+        atta::vec3 gain;
+        for (uint32_t c = 0; c < 3; c++)
+            gain[c] = std::clamp(1.0f / (vignetting * shading[c]), 0.0f, LENS_SHADING_MAX_GAIN);
+        return gain;
+    };
+
+    // Cell of a pixel coordinate (the last node belongs to the last cell) and position inside the cell
+    auto cell = [](const auto& nodes, uint32_t p, uint32_t& k, float& t) {
+        k = 0;
+        while (k + 2 < nodes.size() && nodes[k + 1] <= p)
+            k++;
+        t = nodes[k + 1] > nodes[k] ? float(p - nodes[k]) / float(nodes[k + 1] - nodes[k]) : 0.0f;
+    };
+
+    for (uint32_t y = 0; y < h; y++) {
+        uint32_t j;
+        float ty;
+        cell(nodeY, y, j, ty);
+        for (uint32_t x = 0; x < w; x++) {
+            size_t idx = (size_t(y) * w + x) * 3;
+            uint32_t i;
+            float tx;
+            cell(nodeX, x, i, tx);
+            atta::vec3 gain = (1.0f - ty) * ((1.0f - tx) * nodeGain(i, j) + tx * nodeGain(i + 1, j)) +
+                              ty * ((1.0f - tx) * nodeGain(i, j + 1) + tx * nodeGain(i + 1, j + 1));
+            for (uint32_t c = 0; c < 3; c++)
+                outData[idx + c] = static_cast<uint8_t>(std::clamp(inData[idx + c] * gain[c], 0.0f, 255.0f));
+        }
+    }
+}
+
+void Project::refProChromaticAberrationCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    const CalibrationProfile profile = correctionProfile();
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            size_t idx = (size_t(y) * w + x) * 3;
+            // Compute normalized radial distance
+            atta::vec2 delta = atta::vec2(x, y) - center;
+            float r = delta.length() / center.length();
+            float r2 = r * r;
+            float r3 = r2 * r;
+
+            // Calculate chromatic aberration displacement for Red channel
+            float displacementR = (profile.chromaticAberrationCoeffsR[0] * r2 + profile.chromaticAberrationCoeffsR[1] * r3);
+            float sxR_float = center.x + delta.x * (1.0f - displacementR);
+            float syR_float = center.y + delta.y * (1.0f - displacementR);
+
+            // Calculate chromatic aberration displacement for Blue channel
+            float displacementB = (profile.chromaticAberrationCoeffsB[0] * r2 + profile.chromaticAberrationCoeffsB[1] * r3);
+            float sxB_float = center.x + delta.x * (1.0f - displacementB);
+            float syB_float = center.y + delta.y * (1.0f - displacementB);
+
+            // Sample the displaced channels
+            outData[idx + 0] = (uint8_t)refSampling(inData, w, h, sxR_float, syR_float).x;
+            outData[idx + 1] = inData[idx + 1];
+            outData[idx + 2] = (uint8_t)refSampling(inData, w, h, sxB_float, syB_float).z;
+        }
+    }
+}
+
+void Project::refProLensCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    atta::vec2 center(w / 2.0f, h / 2.0f);
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            size_t idx = (size_t(y) * w + x) * 3;
+
+            // Compute normalized radial distance
+            atta::vec2 delta = atta::vec2(x, y) - center;
+            float r = delta.length() / center.length();
+            float r2 = r * r;
+            float r4 = r2 * r2;
+
+            // Compute inverse barrel distortion polynomial
+            float denom = _barrelDistortionCoeffs[0] + _barrelDistortionCoeffs[1] * r2 + _barrelDistortionCoeffs[2] * r4;
+            if (std::abs(denom) < 1e-3f)
+                denom = 1e-3f; // Avoid division by zero
+            float lensR = r / denom;
+
+            // Compute angle
+            float angle = 0.0f;
+            if (delta.squareLength() > 1e-5f)
+                angle = std::atan2(delta.y, delta.x); // Avoid division by zero at the exact center
+
+            // Compute source pixel coordinates
+            float xDist = center.x + lensR * std::cos(angle) * center.length();
+            float yDist = center.y + lensR * std::sin(angle) * center.length();
+
+            if (xDist < 0.0f || xDist >= w || yDist < 0.0f || yDist >= h) {
+                // Out of bounds, set to black
+                outData[idx + 0] = 0;
+                outData[idx + 1] = 0;
+                outData[idx + 2] = 0;
+                continue;
+            }
+
+            // Sample distorted coordinate in source image
+            atta::vec3 pixel = refSampling(inData, w, h, xDist, yDist);
+            outData[idx + 0] = static_cast<uint8_t>(pixel.x);
+            outData[idx + 1] = static_cast<uint8_t>(pixel.y);
+            outData[idx + 2] = static_cast<uint8_t>(pixel.z);
+        }
+    }
+}
+
+void Project::refProWhiteBalanceCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    const atta::vec3 gains = tempToGain(_colorTemperature);
+    for (size_t i = 0; i < size_t(w) * h; i++) {
+        // Apply the inverse temperature gain to each channel
+        for (uint32_t c = 0; c < 3; c++)
+            outData[i * 3 + c] = static_cast<uint8_t>(std::clamp(inData[i * 3 + c] / gains[c], 0.0f, 255.0f));
+    }
+}
+
+void Project::refProColorCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    const std::array<float, 9>& m = _colorCorrectionMatrix;
+    const uint32_t dim = _colorLutDim;
+    for (size_t i = 0; i < size_t(w) * h; i++) {
+        const uint8_t* inPix = &inData[i * 3];
+        uint8_t* outPix = &outData[i * 3];
+
+        if (_colorLutFile.empty()) {
+            // Color correction matrix, transfer curve and tone curve
+            atta::vec3 in(inPix[0] / 255.0f, inPix[1] / 255.0f, inPix[2] / 255.0f);
+            for (uint32_t c = 0; c < 3; c++) {
+                float value = std::clamp(m[c * 3] * in.x + m[c * 3 + 1] * in.y + m[c * 3 + 2] * in.z, 0.0f, 1.0f);
+                outPix[c] = static_cast<uint8_t>(applyToneCurve(value) * 255.0f + 0.5f);
+            }
+            continue;
+        }
+
+        // LUT loaded from file, tetrahedral interpolation: starting at the lower corner of the cell, the path to the upper corner moves along
+        // the axes in decreasing order of the position inside the cell, and the corners of the path are weighted by the differences of the
+        // sorted positions
+        std::array<uint32_t, 3> cell;
+        std::array<std::pair<float, uint32_t>, 3> frac; // (position inside the cell, axis)
+        for (uint32_t a = 0; a < 3; a++) {
+            float pos = inPix[a] * (dim - 1) / 255.0f;
+            cell[a] = std::min(uint32_t(pos), dim - 2);
+            frac[a] = {pos - cell[a], a};
+        }
+        std::stable_sort(frac.begin(), frac.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        auto lutValue = [&](const std::array<uint32_t, 3>& p, uint32_t c) { return float(_colorLut[((p[2] * dim + p[1]) * dim + p[0]) * 3 + c]); };
+        std::array<std::array<uint32_t, 3>, 4> corners = {cell, cell, cell, cell};
+        for (uint32_t k = 1; k < 4; k++) {
+            corners[k] = corners[k - 1];
+            corners[k][frac[k - 1].second]++;
+        }
+        const std::array<float, 4> weights = {1.0f - frac[0].first, frac[0].first - frac[1].first, frac[1].first - frac[2].first, frac[2].first};
+        for (uint32_t c = 0; c < 3; c++) {
+            float value = 0.0f;
+            for (uint32_t k = 0; k < 4; k++)
+                value += weights[k] * lutValue(corners[k], c);
+            outPix[c] = static_cast<uint8_t>(value * (255.0f / 65535.0f) + 0.5f);
+        }
+    }
+}
+
+void Project::refCopy(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const {
+    std::memcpy(outData, inData, size_t(w) * h * 3);
+}
+
+atta::vec3 Project::refSampling(const uint8_t* data, uint32_t w, uint32_t h, float x, float y) const {
+    if (_interpolation == Interpolation::NEAREST) {
+        // Convert to integer coordinates and clamp (Nearest Neighbor sampling)
+        uint32_t sx = std::clamp(int(std::round(x)), 0, int(w) - 1);
+        uint32_t sy = std::clamp(int(std::round(y)), 0, int(h) - 1);
+        const uint8_t* pixel = &data[(size_t(sy) * w + sx) * 3];
+        return atta::vec3(pixel[0], pixel[1], pixel[2]);
+    }
+
+    // Determine the integer coordinates of the top-left pixel of the 2x2 grid
+    int x0 = static_cast<int>(std::floor(x));
+    int y0 = static_cast<int>(std::floor(y));
+    int x1 = x0 + 1;
+    int y1 = y0 + 1;
+
+    // Calculate fractional parts for interpolation
+    float fx = x - static_cast<float>(x0);
+    float fy = y - static_cast<float>(y0);
+
+    // Helper lambda to get pixel value with clamping and conversion to float atta::vec3
+    auto get_pixel = [&](int xi, int yi) {
+        // Clamp coordinates to be within image bounds
+        int clamped_x = std::clamp(xi, 0, static_cast<int>(w) - 1);
+        int clamped_y = std::clamp(yi, 0, static_cast<int>(h) - 1);
+        const uint8_t* pixel = &data[(size_t(clamped_y) * w + clamped_x) * 3];
+        return atta::vec3(static_cast<float>(pixel[0]), static_cast<float>(pixel[1]), static_cast<float>(pixel[2]));
+    };
+
+    // Get the color values of the four surrounding pixels
+    atta::vec3 q00 = get_pixel(x0, y0); // Top-left
+    atta::vec3 q10 = get_pixel(x1, y0); // Top-right
+    atta::vec3 q01 = get_pixel(x0, y1); // Bottom-left
+    atta::vec3 q11 = get_pixel(x1, y1); // Bottom-right
+
+    // Interpolate along the x-axis for the top and bottom rows, then along the y-axis
+    atta::vec3 p0 = q00 * (1.0f - fx) + q10 * fx;
+    atta::vec3 p1 = q01 * (1.0f - fx) + q11 * fx;
+    return p0 * (1.0f - fy) + p1 * fy;
+}
+
+bool Project::refIsDeadPixel(uint32_t y, uint32_t i) const {
+    // Each color value of a row fails with probability _percentDeadPixels (one random key per row, indexed by the value in the row)
+    const uint32_t threshold = uint32_t(std::clamp(double(_percentDeadPixels), 0.0, 1.0) * 4294967295.0);
+    return randomHash(randomHash(randomHash(42, 1), y), i) < threshold;
+}
+
+bool Project::processOutOfCore(const fs::path& inputPath, const fs::path& outputPath) {
+    auto start = std::chrono::steady_clock::now();
+    MappedFile input;
+    FrameLayout layout;
+    size_t inputOffset = input.open(inputPath) ? parsePnmHeader(input.data, input.size, layout) : 0;
+    if (inputOffset == 0 || layout.format != PixelFormat::RGB || inputOffset + layout.size() > input.size) {
+        LOG_ERROR("Out-of-core", "Could not read [w]$0[] (expected a binary PPM with 8-bit samples)", inputPath.string());
+        return false;
+    }
+    const uint32_t w = layout.width;
+    const uint32_t h = layout.height;
+    const uint32_t ch = 3;
+    const uint32_t tileSize = uint32_t(_outOfCoreTileSize);
+    const size_t rowSize = size_t(w) * ch;
+
+    // Convert the input to the tiled format one band of tiles at a time, dropping each band of the input from memory once converted
+    TiledImage tiled;
+    fs::path tiledPath = outputPath;
+    tiledPath += ".tiles";
+    if (!tiled.create(tiledPath, w, h, ch, tileSize)) {
+        LOG_ERROR("Out-of-core", "Could not create tiled image [w]$0[]", tiledPath.string());
+        return false;
+    }
+    const size_t bandBytes = size_t(tiled.tilesX) * tiled.tileBytes();
+    for (uint32_t ty = 0; ty < tiled.tilesY; ty++) {
+        uint32_t y0 = ty * tileSize;
+        uint32_t rows = std::min(tileSize, h - y0);
+        for (uint32_t r = 0; r < rows; r++) {
+            const uint8_t* row = input.data + inputOffset + (y0 + r) * rowSize;
+            for (uint32_t tx = 0; tx < tiled.tilesX; tx++) {
+                uint32_t x0 = tx * tileSize;
+                std::memcpy(tiled.tile(tx, ty) + size_t(r) * tileSize * ch, row + size_t(x0) * ch, size_t(std::min(tileSize, w - x0)) * ch);
+            }
+        }
+        input.release(inputOffset + y0 * rowSize, rows * rowSize);
+        tiled.file.release(TiledImage::HEADER_SIZE + ty * bandBytes, bandBytes);
+    }
+    input.close();
+
+    // The output tiles are written in place to the output image
+    const std::string header = "P6\n" + std::to_string(w) + " " + std::to_string(h) + "\n255\n";
+    MappedFile output;
+    if (!output.create(outputPath, header.size() + h * rowSize)) {
+        LOG_ERROR("Out-of-core", "Could not create output image [w]$0[]", outputPath.string());
+        return false;
+    }
+    std::memcpy(output.data, header.data(), header.size());
+
+    // Stages that change the image (the output stages only copy it)
+    std::vector<const Stage*> stages;
+    for (const Stage& stage : _stages)
+        if (stage.func != &Project::copyStage)
+            stages.push_back(&stage);
+    prepareStages(w, h, ch);
+
+    std::mutex mutex;
+    size_t bufferSize = 0;
+    for (uint32_t ty = 0; ty < tiled.tilesY; ty++) {
+        parallelFor(tiled.tilesX, [&](uint32_t txBegin, uint32_t txEnd) {
+            std::vector<uint8_t> a; // Stage input
+            std::vector<uint8_t> b; // Stage output
+            std::vector<Region> regions(stages.size() + 1);
+            for (uint32_t tx = txBegin; tx < txEnd; tx++) {
+                // Input region of each stage, from the output tile back to the first stage
+                const Region tile{tx * tileSize, ty * tileSize, std::min(tileSize, w - tx * tileSize), std::min(tileSize, h - ty * tileSize)};
+                regions.back() = tile;
+                for (size_t s = stages.size(); s-- > 0;) {
+                    uint32_t halo = stages[s]->halo ? (this->*stages[s]->halo)(regions[s + 1], w, h) : 0;
+                    regions[s] = growRegion(regions[s + 1], halo, w, h);
+                }
+
+                // Regions only shrink along the pipeline, so the buffers are sized by the first one
+                a.resize(size_t(regions[0].w) * regions[0].h * ch);
+                b.resize(a.size());
+                tiled.readRegion(regions[0], a.data());
+                if (_planarLayout) {
+                    interleavedToPlanar(a.data(), b.data(), size_t(regions[0].w) * regions[0].h, ch);
+                    std::swap(a, b);
+                }
+                for (size_t s = 0; s < stages.size(); s++) {
+                    (this->*stages[s]->func)(a.data(), b.data(), w, h, ch, Tile{regions[s], regions[s + 1], _planarLayout});
+                    std::swap(a, b);
+                }
+                if (_planarLayout) {
+                    planarToInterleaved(a.data(), b.data(), size_t(tile.w) * tile.h, ch);
+                    std::swap(a, b);
+                }
+
+                for (uint32_t r = 0; r < tile.h; r++)
+                    std::memcpy(output.data + header.size() + (tile.y + r) * rowSize + size_t(tile.x) * ch, &a[size_t(r) * tile.w * ch],
+                                size_t(tile.w) * ch);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            bufferSize = std::max(bufferSize, a.capacity() + b.capacity());
+        });
+
+        // Write the finished band to disk and drop it from memory
+        output.release(header.size() + ty * tileSize * rowSize, std::min(tileSize, h - ty * tileSize) * rowSize);
+    }
+
+    output.close();
+    tiled.file.close();
+    fs::remove(tiledPath);
+
+    _outOfCoreBufferSize = bufferSize;
+    _outOfCoreTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("Out-of-core", "Processed $0x$1 image in $2 ms ($3 tiles, largest tile buffers $4 MB per thread)", w, h, _outOfCoreTime,
+             tiled.tilesX * tiled.tilesY, bufferSize / 1e6f);
+    return true;
+}
+
+bool Project::processBatch(const fs::path& inputDir, const fs::path& outputDir) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Inputs, sorted by size so the stages are prepared once per size
+    struct Item {
+        fs::path path;
+        FrameLayout layout;
+    };
+    std::vector<Item> items;
+    std::error_code error;
+    for (const fs::directory_entry& entry : fs::directory_iterator(inputDir, error)) {
+        const std::string extension = entry.path().extension().string();
+        if (!entry.is_regular_file() || (extension != ".ppm" && extension != ".pgm"))
+            continue;
+        MappedFile file;
+        Item item{entry.path(), {}};
+        size_t offset = file.open(item.path) ? parsePnmHeader(file.data, file.size, item.layout) : 0;
+        if (offset == 0 || offset + item.layout.size() > file.size) {
+            LOG_WARN("Batch", "Skipping [w]$0[] (expected a binary PPM/PGM with 8-bit samples)", item.path.string());
+            continue;
+        }
+        items.push_back(item);
+    }
+    if (error || items.empty()) {
+        LOG_ERROR("Batch", "No PPM/PGM images found in [w]$0[]", inputDir.string());
+        return false;
+    }
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return std::tie(a.layout.width, a.layout.height, a.path) < std::tie(b.layout.width, b.layout.height, b.path);
+    });
+    fs::create_directories(outputDir, error);
+
+    auto lastStageIt = std::find_if(_stages.begin(), _stages.end(), [&](const Stage& s) { return s.name == _batchOutputStage; });
+    const size_t lastStage = lastStageIt == _stages.end() ? _stages.size() - 1 : size_t(lastStageIt - _stages.begin());
+
+    // Frame slots and worker arenas, all sized to the largest input
+    struct Frame {
+        std::vector<uint8_t> data; // RGB input, replaced by the output
+        size_t item = 0;
+        bool valid = false; // Whether the input was decoded
+    };
+    const uint32_t numWorkers = _batchWorkers > 0 ? uint32_t(_batchWorkers) : std::max(1u, std::thread::hardware_concurrency());
+    size_t frameSize = 0;
+    for (const Item& item : items)
+        frameSize = std::max(frameSize, size_t(item.layout.width) * item.layout.height * 3);
+    std::vector<Frame> frames(numWorkers * (BATCH_PREFETCH_FRAMES + 1));
+    for (Frame& frame : frames)
+        frame.data.resize(frameSize);
+    std::vector<std::array<std::vector<uint8_t>, 2>> arenas(numWorkers);
+    for (std::array<std::vector<uint8_t>, 2>& arena : arenas)
+        for (std::vector<uint8_t>& buffer : arena)
+            buffer.resize(frameSize);
+
+    size_t steals = 0;
+    size_t failed = 0;
+    for (size_t groupBegin = 0; groupBegin < items.size();) {
+        const uint32_t w = items[groupBegin].layout.width;
+        const uint32_t h = items[groupBegin].layout.height;
+        size_t groupEnd = groupBegin;
+        while (groupEnd < items.size() && items[groupEnd].layout.width == w && items[groupEnd].layout.height == h)
+            groupEnd++;
+        prepareStages(w, h, 3);
+
+        // Frames move from the free slots to the worker queues (decoded), and then to the written queue (processed). Each image takes
+        // milliseconds, so a single mutex for all queues does not limit the scaling
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<Frame*> freeFrames;
+        for (Frame& frame : frames)
+            freeFrames.push_back(&frame);
+        std::vector<std::deque<Frame*>> queues(numWorkers);
+        std::deque<Frame*> processed;
+        size_t queued = 0;
+        bool readDone = false;
+
+        std::vector<std::thread> workers;
+        for (uint32_t id = 0; id < numWorkers; id++) {
+            workers.emplace_back([&, id]() {
+                runSerial([&]() {
+                    while (true) {
+                        Frame* frame = nullptr;
+                        {
+                            std::unique_lock<std::mutex> lock(mutex);
+                            cv.wait(lock, [&]() { return queued > 0 || readDone; });
+                            if (queued == 0)
+                                return;
+                            for (uint32_t k = 0; frame == nullptr; k++) {
+                                std::deque<Frame*>& queue = queues[(id + k) % numWorkers];
+                                if (queue.empty())
+                                    continue;
+                                frame = k == 0 ? queue.back() : queue.front();
+                                k == 0 ? queue.pop_back() : queue.pop_front();
+                                steals += k > 0;
+                            }
+                            queued--;
+                        }
+                        if (frame->valid)
+                            processBatchFrame(frame->data.data(), w, h, lastStage, arenas[id]);
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            processed.push_back(frame);
+                        }
+                        cv.notify_all();
+                    }
+                });
+            });
+        }
+
+        std::thread writer([&]() {
+            for (size_t i = groupBegin; i < groupEnd; i++) {
+                Frame* frame = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&]() { return !processed.empty(); });
+                    frame = processed.front();
+                    processed.pop_front();
+                }
+                if (frame->valid) {
+                    const fs::path path = outputDir / items[frame->item].path.filename().replace_extension(".ppm");
+                    std::ofstream file(path, std::ios::binary);
+                    file << "P6\n" << w << " " << h << "\n255\n";
+                    file.write(reinterpret_cast<const char*>(frame->data.data()), std::streamsize(size_t(w) * h * 3));
+                    if (!file) {
+                        LOG_ERROR("Batch", "Could not write [w]$0[]", path.string());
+                        frame->valid = false;
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    failed += !frame->valid;
+                    freeFrames.push_back(frame);
+                }
+                cv.notify_all();
+            }
+        });
+
+        // Decode the inputs into free slots, prefetching the next file while waiting for a slot
+        for (size_t i = groupBegin; i < groupEnd; i++) {
+            MappedFile file;
+            FrameLayout layout;
+            size_t offset = file.open(items[i].path) ? parsePnmHeader(file.data, file.size, layout) : 0;
+            bool valid = offset != 0 && layout.width == w && layout.height == h && offset + layout.size() <= file.size;
+            if (valid)
+                file.prefetch(offset, layout.size());
+
+            Frame* frame = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return !freeFrames.empty(); });
+                frame = freeFrames.back();
+                freeFrames.pop_back();
+            }
+            if (valid)
+                convertFrame(file.data + offset, layout, frame->data.data());
+            else
+                LOG_ERROR("Batch", "Could not read [w]$0[]", items[i].path.string());
+            frame->item = i;
+            frame->valid = valid;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queues[i % numWorkers].push_back(frame);
+                queued++;
+            }
+            cv.notify_all();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            readDone = true;
+        }
+        cv.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        writer.join();
+        groupBegin = groupEnd;
+    }
+
+    _batchImages = items.size() - failed;
+    _batchSteals = steals;
+    _batchTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("Batch", "Processed $0 images in $1 ms ($2 images/s, $3 workers, $4 steals, $5 MB of frame buffers)", _batchImages, _batchTime,
+             _batchImages * 1000.0f / _batchTime, numWorkers, steals, (frames.size() + 2 * numWorkers) * frameSize / 1e6f);
+    return failed == 0;
+}
+
+void Project::processBatchFrame(uint8_t* data, uint32_t w, uint32_t h, size_t lastStage, std::array<std::vector<uint8_t>, 2>& arena) const {
+    // The stages alternate between the arena buffers, the output stages only copy the frame so they are skipped
+    const size_t pixels = size_t(w) * h;
+    const Tile frame = fullFrame(w, h, _planarLayout);
+    const uint8_t* inData = data;
+    if (_planarLayout) {
+        interleavedToPlanar(data, arena[1].data(), pixels, 3);
+        inData = arena[1].data();
+    }
+    int out = 0;
+    for (size_t s = 0; s <= lastStage; s++) {
+        if (_stages[s].func == &Project::copyStage)
+            continue;
+        (this->*_stages[s].func)(inData, arena[out].data(), w, h, 3, frame);
+        inData = arena[out].data();
+        out ^= 1;
+    }
+    if (_planarLayout)
+        planarToInterleaved(inData, data, pixels, 3);
+    else if (inData != data)
+        std::memcpy(data, inData, pixels * 3);
+}
+
+bool Project::processStreams(const std::vector<std::string>& streams, const fs::path& outputDir) {
+    auto start = std::chrono::steady_clock::now();
+    std::error_code error;
+    fs::create_directories(outputDir, error);
+
+    // Stream contexts, each with its own mapped input and output file
+    auto trim = [](const std::string& str) {
+        const size_t begin = str.find_first_not_of(" \t");
+        return begin == std::string::npos ? std::string() : str.substr(begin, str.find_last_not_of(" \t") - begin + 1);
+    };
+    std::vector<std::unique_ptr<StreamContext>> contexts;
+    for (const std::string& stream : streams) {
+        if (trim(stream).empty())
+            continue;
+        StreamContext& context = *contexts.emplace_back(std::make_unique<StreamContext>());
+        const size_t comma = stream.find(',');
+        context.input = trim(stream.substr(0, comma));
+        context.calibration = comma == std::string::npos ? "" : trim(stream.substr(comma + 1));
+
+        const std::string extension = fs::path(context.input).extension().string();
+        const bool raw = extension == ".raw" || extension == ".yuv";
+        if (context.file.open(context.input))
+            indexFrames(context.file, raw, context.layout, context.frames);
+        if (context.frames.empty()) {
+            LOG_ERROR("Streams", "Could not read frames from [w]$0[] (expected a PPM/PGM, Y4M or raw file)", context.input);
+            context.failed = true;
+            continue;
+        }
+        const std::string name = "stream" + std::to_string(contexts.size() - 1) + "_" + fs::path(context.input).stem().string();
+        const fs::path outputPath = outputDir / (name + ".ppm");
+        context.output.open(outputPath, std::ios::binary);
+        if (!context.output) {
+            LOG_ERROR("Streams", "Could not create [w]$0[]", outputPath.string());
+            context.failed = true;
+            continue;
+        }
+        context.frame.resize(size_t(context.layout.width) * context.layout.height * 3);
+    }
+
+    // Group the streams by camera module (calibration profile) and frame size, and prepare the stage state of each group once. The groups
+    // only share the color LUT, which does not depend on the camera module
+    std::vector<StreamContext*> order;
+    for (const std::unique_ptr<StreamContext>& context : contexts)
+        if (!context->failed)
+            order.push_back(context.get());
+    std::stable_sort(order.begin(), order.end(), [](const StreamContext* a, const StreamContext* b) {
+        return std::tie(a->calibration, a->layout.width, a->layout.height) < std::tie(b->calibration, b->layout.width, b->layout.height);
+    });
+    if (_colorLutDirty)
+        buildColorLut();
+    std::vector<std::unique_ptr<CameraModule>> cameras;
+    std::vector<StreamContext*> streamsToRun;
+    size_t frameSize = 0;
+    for (size_t groupBegin = 0; groupBegin < order.size();) {
+        const std::string& profile = order[groupBegin]->calibration;
+        const uint32_t w = order[groupBegin]->layout.width;
+        const uint32_t h = order[groupBegin]->layout.height;
+        size_t groupEnd = groupBegin;
+        while (groupEnd < order.size() && order[groupEnd]->calibration == profile && order[groupEnd]->layout.width == w &&
+               order[groupEnd]->layout.height == h)
+            groupEnd++;
+        const std::vector<StreamContext*> group(order.begin() + groupBegin, order.begin() + groupEnd);
+        groupBegin = groupEnd;
+
+        // Stage state of the camera module, starting from the current profile
+        std::unique_ptr<CameraModule> camera = std::make_unique<CameraModule>();
+        camera->calibration = _camera.calibration;
+        camera->useCalibration = _camera.useCalibration;
+        if (!profile.empty() && !(camera->useCalibration = loadCalibrationProfile(profile, *camera))) {
+            LOG_ERROR("Streams", "Could not load calibration profile [w]$0[]", profile);
+            for (StreamContext* stream : group)
+                stream->failed = true;
+            continue;
+        }
+        prepareCamera(*camera, w, h, 3);
+        for (StreamContext* stream : group) {
+            stream->camera = camera.get();
+            streamsToRun.push_back(stream);
+        }
+        cameras.push_back(std::move(camera));
+        frameSize = std::max(frameSize, size_t(w) * h * 3);
+    }
+
+    // Worker arenas, large enough for the frames of every group
+    auto lastStageIt = std::find_if(_stages.begin(), _stages.end(), [&](const Stage& s) { return s.name == _streamOutputStage; });
+    const size_t lastStage = lastStageIt == _stages.end() ? _stages.size() - 1 : size_t(lastStageIt - _stages.begin());
+    const uint32_t maxWorkers = _streamWorkers > 0 ? uint32_t(_streamWorkers) : std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t numWorkers = std::min(maxWorkers, uint32_t(streamsToRun.size()));
+    std::vector<std::array<std::vector<uint8_t>, 2>> arenas(numWorkers);
+    for (std::array<std::vector<uint8_t>, 2>& arena : arenas)
+        for (std::vector<uint8_t>& buffer : arena)
+            buffer.resize(frameSize);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t remaining = streamsToRun.size(); // Streams with frames left
+    size_t frameCount = 0;
+    auto nextStream = [&]() {
+        StreamContext* next = nullptr;
+        for (StreamContext* stream : streamsToRun)
+            if (!stream->busy && stream->next < stream->frames.size() && (next == nullptr || stream->next < next->next))
+                next = stream;
+        return next;
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t id = 0; id < numWorkers; id++) {
+        workers.emplace_back([&, id]() {
+            runSerial([&]() {
+                while (true) {
+                    StreamContext* stream = nullptr;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        cv.wait(lock, [&]() { return (stream = nextStream()) != nullptr || remaining == 0; });
+                        if (stream == nullptr)
+                            return;
+                        stream->busy = true;
+                    }
+
+                    // The stream is only accessed by this worker until it is released, and its camera module is only read
+                    auto frameStart = std::chrono::steady_clock::now();
+                    const size_t f = stream->next;
+                    const uint32_t w = stream->layout.width;
+                    const uint32_t h = stream->layout.height;
+                    convertFrame(stream->file.data + stream->frames[f], stream->layout, stream->frame.data());
+                    if (f + 1 < stream->frames.size())
+                        stream->file.prefetch(stream->frames[f + 1], stream->layout.size());
+                    runWithCamera(*stream->camera, [&]() { processBatchFrame(stream->frame.data(), w, h, lastStage, arenas[id]); });
+                    stream->output << "P6\n" << w << " " << h << "\n255\n";
+                    stream->output.write(reinterpret_cast<const char*>(stream->frame.data()), std::streamsize(stream->frame.size()));
+                    stream->time += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        stream->busy = false;
+                        stream->next++;
+                        frameCount++;
+                        if (!stream->output) {
+                            LOG_ERROR("Streams", "Could not write the output of [w]$0[]", stream->input);
+                            stream->failed = true;
+                            stream->next = stream->frames.size();
+                        }
+                        remaining -= stream->next == stream->frames.size();
+                    }
+                    cv.notify_all();
+                }
+            });
+        });
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+
+    _streamResults.clear();
+    bool ok = !contexts.empty();
+    for (const std::unique_ptr<StreamContext>& context : contexts) {
+        _streamResults.push_back({context->input, context->next, context->time, context->failed});
+        ok &= !context->failed;
+    }
+    size_t arenaSize = 0;
+    for (const std::array<std::vector<uint8_t>, 2>& arena : arenas)
+        arenaSize += arena[0].size() + arena[1].size();
+    _streamTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("Streams", "Processed $0 frames of $1 streams in $2 ms ($3 frames/s, $4 module/size groups, $5 MB of worker arenas)", frameCount,
+             contexts.size(), _streamTime, frameCount * 1000.0f / _streamTime, cameras.size(), arenaSize / 1e6f);
+    return ok;
+}
+
+bool Project::MappedFile::open(const fs::path& path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        close();
+        return false;
+    }
+    void* ptr = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        close();
+        return false;
+    }
+    data = static_cast<uint8_t*>(ptr);
+    size = size_t(info.st_size);
+    return true;
+}
+
+bool Project::MappedFile::create(const fs::path& path, size_t fileSize) {
+    close();
+    // The file is sparse, disk space is only used when the pages are written
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, off_t(fileSize)) != 0) {
+        close();
+        return false;
+    }
+    void* ptr = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        close();
+        return false;
+    }
+    data = static_cast<uint8_t*>(ptr);
+    size = fileSize;
+    return true;
+}
+
+void Project::MappedFile::release(size_t offset, size_t length) {
+    // The range is extended to page boundaries, pages shared with the neighboring data are loaded again when accessed
+    const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+    size_t begin = offset / pageSize * pageSize;
+    size_t end = std::min(size, offset + length);
+    if (data == nullptr || end <= begin)
+        return;
+    msync(data + begin, end - begin, MS_SYNC);
+    madvise(data + begin, end - begin, MADV_DONTNEED);
+}
+
+void Project::MappedFile::prefetch(size_t offset, size_t length) const {
+    const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+    size_t begin = offset / pageSize * pageSize;
+    size_t end = std::min(size, offset + length);
+    if (data != nullptr && end > begin)
+        madvise(data + begin, end - begin, MADV_WILLNEED);
+}
+
+void Project::MappedFile::close() {
+    if (data != nullptr)
+        munmap(data, size);
+    if (fd >= 0)
+        ::close(fd);
+    data = nullptr;
+    size = 0;
+    fd = -1;
+}
+
+bool Project::TiledImage::create(const fs::path& path, uint32_t w, uint32_t h, uint32_t ch, uint32_t size) {
+    width = w;
+    height = h;
+    channels = ch;
+    tileSize = size;
+    tilesX = (w + size - 1) / size;
+    tilesY = (h + size - 1) / size;
+    if (!file.create(path, HEADER_SIZE + size_t(tilesX) * tilesY * tileBytes()))
+        return false;
+
+    // Header with a magic number, version and image dimensions
+    const std::array<uint32_t, 6> header = {0x454c4954 /* "TILE" */, 1, width, height, channels, tileSize};
+    std::memcpy(file.data, header.data(), sizeof(header));
+    return true;
+}
+
+void Project::TiledImage::readRegion(const Region& region, uint8_t* outData) const {
+    for (uint32_t y = region.y; y < region.y + region.h; y++) {
+        uint8_t* outRow = &outData[size_t(y - region.y) * region.w * channels];
+        // Copy the part of the row inside each tile
+        for (uint32_t x = region.x; x < region.x + region.w;) {
+            uint32_t tx = x / tileSize;
+            uint32_t count = std::min(region.x + region.w, (tx + 1) * tileSize) - x;
+            const uint8_t* tileRow = tile(tx, y / tileSize) + (size_t(y % tileSize) * tileSize + x % tileSize) * channels;
+            std::memcpy(&outRow[size_t(x - region.x) * channels], tileRow, size_t(count) * channels);
+            x += count;
+        }
+    }
+}
+
+bool Project::openInput(const fs::path& path) {
+    closeInput();
+
+    // Streams are read as the frames arrive, the container is detected from the first bytes
+    std::error_code error;
+    if (path == "-" || fs::is_fifo(path, error)) {
+        // Opening a FIFO without O_NONBLOCK would block until a writer connects. Once opened, reads block until the whole frame arrives
+        _inputFd = path == "-" ? dup(STDIN_FILENO) : ::open(path.c_str(), O_RDONLY | O_NONBLOCK);
+        if (_inputFd < 0) {
+            LOG_ERROR("Input", "Could not open stream [w]$0[]", path.string());
+            return false;
+        }
+        fcntl(_inputFd, F_SETFL, fcntl(_inputFd, F_GETFL) & ~O_NONBLOCK);
+        LOG_INFO("Input", "Waiting for frames from [w]$0[]", path.string());
+        return true;
+    }
+
+    // Compressed images are decoded by atta
+    const std::string extension = path.extension().string();
+    const bool raw = extension == ".raw" || extension == ".yuv";
+    if (!raw && extension != ".ppm" && extension != ".pgm" && extension != ".y4m") {
+        res::Image* ref = res::get<res::Image>("reference");
+        ref->load(path);
+        resizeFrame(ref->getWidth(), ref->getHeight());
+        _inputContainer = InputContainer::IMAGE;
+        _inputLayout = FrameLayout{PixelFormat::RGB, ref->getWidth(), ref->getHeight()};
+        return true;
+    }
+
+    if (!_inputFile.open(path)) {
+        LOG_ERROR("Input", "Could not open [w]$0[]", path.string());
+        return false;
+    }
+    _inputContainer = indexFrames(_inputFile, raw, _inputLayout, _inputFrames);
+    if (_inputFrames.empty()) {
+        LOG_ERROR("Input", "No complete frame in [w]$0[]", path.string());
+        closeInput();
+        return false;
+    }
+    LOG_INFO("Input", "Opened [w]$0[] ($1 frames of $2x$3)", path.string(), _inputFrames.size(), _inputLayout.width, _inputLayout.height);
+    return readInputFrame();
+}
+
+Project::InputContainer Project::indexFrames(const MappedFile& file, bool raw, FrameLayout& layout, std::vector<size_t>& frames) const {
+    const uint8_t* data = file.data;
+    const size_t size = file.size;
+    if (size >= 10 && std::memcmp(data, "YUV4MPEG2 ", 10) == 0) {
+        // Stream header line, then every frame starts with a "FRAME" line (optionally with parameters)
+        const uint8_t* headerEnd = static_cast<const uint8_t*>(std::memchr(data, '\n', size));
+        if (headerEnd != nullptr && parseY4mHeader(std::string(data, headerEnd), layout)) {
+            size_t pos = headerEnd - data + 1;
+            while (pos + 5 <= size && std::memcmp(data + pos, "FRAME", 5) == 0) {
+                const uint8_t* lineEnd = static_cast<const uint8_t*>(std::memchr(data + pos, '\n', size - pos));
+                if (lineEnd == nullptr || size_t(lineEnd - data) + 1 + layout.size() > size)
+                    break;
+                frames.push_back(lineEnd - data + 1);
+                pos = frames.back() + layout.size();
+            }
+        }
+        return InputContainer::Y4M;
+    }
+    if (!raw) {
+        // Concatenated PPM/PGM images with the same layout
+        size_t pos = 0;
+        FrameLayout frameLayout;
+        while (size_t headerSize = parsePnmHeader(data + pos, size - pos, frameLayout)) {
+            if (pos + headerSize + frameLayout.size() > size ||
+                (!frames.empty() && (frameLayout.format != layout.format || frameLayout.width != layout.width ||
+                                     frameLayout.height != layout.height)))
+                break;
+            layout = frameLayout;
+            frames.push_back(pos + headerSize);
+            pos = frames.back() + frameLayout.size();
+        }
+        return InputContainer::PNM;
+    }
+
+    // Headerless frames with the layout selected in the UI
+    layout = _rawLayout;
+    for (size_t pos = 0; layout.size() > 0 && pos + layout.size() <= size; pos += layout.size())
+        frames.push_back(pos);
+    return InputContainer::RAW;
+}
+
+void Project::closeInput() {
+    if (_inputFd >= 0)
+        ::close(_inputFd);
+    _inputFd = -1;
+    _inputFile.close();
+    _inputContainer = InputContainer::NONE;
+    _inputFrames.clear();
+    _inputFrame = 0;
+    _inputPending.clear();
+}
+
+bool Project::readInputFrame() {
+    if (_inputFd >= 0)
+        return readStreamFrame();
+    if (_inputFrames.empty())
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+    resizeFrame(_inputLayout.width, _inputLayout.height);
+    convertFrame(_inputFile.data + _inputFrames[_inputFrame], _inputLayout, res::get<res::Image>("reference")->getData());
+
+    // Read the next frame from disk while this one is processed
+    _inputFile.prefetch(_inputFrames[(_inputFrame + 1) % _inputFrames.size()], _inputLayout.size());
+    _inputTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool Project::readStreamFrame() {
+    // Only start reading when data is available, so the UI keeps running while waiting for frames
+    pollfd pfd{_inputFd, POLLIN, 0};
+    if (_inputPending.empty() && (poll(&pfd, 1, 0) <= 0 || (pfd.revents & (POLLIN | POLLHUP | POLLERR)) == 0))
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+    auto endOfStream = [&](const char* reason) {
+        LOG_INFO("Input", "Input stream closed ($0)", reason);
+        closeInput();
+        return false;
+    };
+
+    // Detect the container from the first bytes, they are kept to be read again as part of the header or frame
+    if (_inputContainer == InputContainer::NONE) {
+        uint8_t magic[2];
+        if (!readStreamBytes(magic, 2))
+            return endOfStream("end of stream");
+        _inputPending.assign(magic, magic + 2);
+        if (_inputPending == "YU") {
+            std::string header;
+            if (!readStreamLine(header) || !parseY4mHeader(header, _inputLayout))
+                return endOfStream("invalid Y4M header");
+            _inputContainer = InputContainer::Y4M;
+        } else if (_inputPending == "P5" || _inputPending == "P6") {
+            _inputContainer = InputContainer::PNM;
+        } else {
+            _inputLayout = _rawLayout;
+            _inputContainer = InputContainer::RAW;
+        }
+    }
+
+    // Frame header
+    if (_inputContainer == InputContainer::Y4M) {
+        std::string line;
+        if (!readStreamLine(line))
+            return endOfStream("end of stream");
+        if (line.compare(0, 5, "FRAME") != 0)
+            return endOfStream("invalid Y4M frame header");
+    } else if (_inputContainer == InputContainer::PNM) {
+        // The header has no length field, so it is read byte by byte until it can be parsed
+        std::string header;
+        size_t headerSize = 0;
+        while (headerSize == 0 && header.size() < INPUT_MAX_HEADER_SIZE) {
+            uint8_t c;
+            if (!readStreamBytes(&c, 1))
+                return endOfStream("end of stream");
+            header += char(c);
+            headerSize = parsePnmHeader(reinterpret_cast<const uint8_t*>(header.data()), header.size(), _inputLayout);
+        }
+        if (headerSize == 0)
+            return endOfStream("invalid PNM header");
+    }
+
+    // RGB frames are read straight into the reference image, other formats are converted after the whole frame arrives
+    resizeFrame(_inputLayout.width, _inputLayout.height);
+    uint8_t* refData = res::get<res::Image>("reference")->getData();
+    if (_inputLayout.format == PixelFormat::RGB) {
+        if (!readStreamBytes(refData, _inputLayout.size()))
+            return endOfStream("end of stream");
+    } else {
+        _inputStaging.resize(_inputLayout.size());
+        if (!readStreamBytes(_inputStaging.data(), _inputStaging.size()))
+            return endOfStream("end of stream");
+        convertFrame(_inputStaging.data(), _inputLayout, refData);
+    }
+    _inputTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool Project::readStreamBytes(uint8_t* data, size_t size) {
+    // Bytes read ahead when detecting the container come first
+    size_t pos = std::min(size, _inputPending.size());
+    std::memcpy(data, _inputPending.data(), pos);
+    _inputPending.erase(0, pos);
+    while (pos < size) {
+        ssize_t count = read(_inputFd, data + pos, size - pos);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        pos += size_t(count);
+    }
+    return true;
+}
+
+bool Project::readStreamLine(std::string& line) {
+    line.clear();
+    while (line.size() < INPUT_MAX_HEADER_SIZE) {
+        uint8_t c;
+        if (!readStreamBytes(&c, 1))
+            return false;
+        if (c == '\n')
+            return true;
+        line += char(c);
+    }
+    return false;
+}
+
+void Project::resizeFrame(uint32_t w, uint32_t h) {
+    std::vector<std::string> names = _stageNames;
+    names.insert(names.begin(), "reference");
+    for (const std::string& name : names) {
+        res::Image* img = res::get<res::Image>(name);
+        if (img->getWidth() != w || img->getHeight() != h)
+            img->resize(w, h);
+        createThumbnail(name);
+    }
+}
+
+size_t Project::FrameLayout::size() const {
+    const size_t pixels = size_t(width) * height;
+    switch (format) {
+        case PixelFormat::RGB:
+        case PixelFormat::YUV444:
+            return pixels * 3;
+        case PixelFormat::GRAY:
+        case PixelFormat::BAYER_RGGB:
+        case PixelFormat::YUV400:
+            return pixels;
+        case PixelFormat::YUV420:
+            return pixels + 2 * size_t((width + 1) / 2) * ((height + 1) / 2);
+    }
+    return 0;
+}
+
+size_t Project::parsePnmHeader(const uint8_t* data, size_t size, FrameLayout& layout) {
+    // Binary PPM (P6) or PGM (P5): width, height and maximum value separated by whitespace (or comments), followed by a single whitespace and
+    // the data
+    if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6'))
+        return 0;
+
+    size_t pos = 2;
+    std::array<uint64_t, 3> values{};
+    for (uint64_t& value : values) {
+        while (pos < size && (std::isspace(data[pos]) || data[pos] == '#')) {
+            if (data[pos] == '#')
+                while (pos < size && data[pos] != '\n')
+                    pos++;
+            else
+                pos++;
+        }
+        if (pos >= size || !std::isdigit(data[pos]))
+            return 0;
+        while (pos < size && std::isdigit(data[pos]) && value <= UINT32_MAX)
+            value = value * 10 + (data[pos++] - '0');
+    }
+
+    // The whitespace after the maximum value must be present, otherwise the header may be incomplete
+    if (pos >= size || !std::isspace(data[pos]) || values[0] == 0 || values[0] > UINT32_MAX || values[1] == 0 || values[1] > UINT32_MAX ||
+        values[2] != 255)
+        return 0;
+    layout.format = data[1] == '6' ? PixelFormat::RGB : PixelFormat::GRAY;
+    layout.width = uint32_t(values[0]);
+    layout.height = uint32_t(values[1]);
+    return pos + 1;
+}
+
+bool Project::parseY4mHeader(const std::string& header, FrameLayout& layout) {
+    // "YUV4MPEG2" followed by parameters starting with a tag letter. Frame rate, interlacing and aspect ratio do not change the frame data
+    std::istringstream stream(header);
+    std::string token;
+    if (!(stream >> token) || token != "YUV4MPEG2")
+        return false;
+    layout = FrameLayout{PixelFormat::YUV420, 0, 0};
+    while (stream >> token) {
+        const std::string value = token.substr(1);
+        if (token[0] == 'W')
+            layout.width = uint32_t(std::strtoul(value.c_str(), nullptr, 10));
+        else if (token[0] == 'H')
+            layout.height = uint32_t(std::strtoul(value.c_str(), nullptr, 10));
+        else if (token[0] == 'C') {
+            // Only 8-bit chroma formats are supported, the 4:2:0 variants only differ in chroma siting
+            if (value == "420" || value == "420jpeg" || value == "420mpeg2" || value == "420paldv")
+                layout.format = PixelFormat::YUV420;
+            else if (value == "444")
+                layout.format = PixelFormat::YUV444;
+            else if (value == "mono")
+                layout.format = PixelFormat::YUV400;
+            else
+                return false;
+        }
+    }
+    return layout.width > 0 && layout.height > 0;
+}
+
+void Project::convertFrame(const uint8_t* frameData, const FrameLayout& layout, uint8_t* outData) {
+    const uint32_t w = layout.width;
+    const uint32_t h = layout.height;
+    switch (layout.format) {
+        case PixelFormat::RGB:
+            std::memcpy(outData, frameData, layout.size());
+            break;
+        case PixelFormat::GRAY:
+            parallelFor(h, [&](uint32_t begin, uint32_t end) {
+                for (size_t i = size_t(begin) * w; i < size_t(end) * w; i++)
+                    outData[i * 3 + 0] = outData[i * 3 + 1] = outData[i * 3 + 2] = frameData[i];
+            });
+            break;
+        case PixelFormat::BAYER_RGGB:
+            // Bilinear demosaicing. Borders are mirrored, which keeps the color of the mirrored site
+            parallelFor(h, [&](uint32_t begin, uint32_t end) {
+                auto at = [&](int x, int y) {
+                    x = x < 0 ? -x : (x >= int(w) ? 2 * int(w) - 2 - x : x);
+                    y = y < 0 ? -y : (y >= int(h) ? 2 * int(h) - 2 - y : y);
+                    return int(frameData[size_t(y) * w + x]);
+                };
+                for (uint32_t y = begin; y < end; y++) {
+                    for (uint32_t x = 0; x < w; x++) {
+                        int xi = int(x);
+                        int yi = int(y);
+                        int center = at(xi, yi);
+                        int horizontal = (at(xi - 1, yi) + at(xi + 1, yi) + 1) / 2;
+                        int vertical = (at(xi, yi - 1) + at(xi, yi + 1) + 1) / 2;
+                        int cross = (at(xi - 1, yi) + at(xi + 1, yi) + at(xi, yi - 1) + at(xi, yi + 1) + 2) / 4;
+                        int diagonal = (at(xi - 1, yi - 1) + at(xi + 1, yi - 1) + at(xi - 1, yi + 1) + at(xi + 1, yi + 1) + 2) / 4;
+
+                        uint8_t* out = &outData[(size_t(y) * w + x) * 3];
+                        std::array<int, 3> rgb;
+                        if (y % 2 == 0 && x % 2 == 0)
+                            rgb = {center, cross, diagonal}; // Red site
+                        else if (y % 2 == 1 && x % 2 == 1)
+                            rgb = {diagonal, cross, center}; // Blue site
+                        else if (y % 2 == 0)
+                            rgb = {horizontal, center, vertical}; // Green site on a red row
+                        else
+                            rgb = {vertical, center, horizontal}; // Green site on a blue row
+                        out[0] = uint8_t(rgb[0]);
+                        out[1] = uint8_t(rgb[1]);
+                        out[2] = uint8_t(rgb[2]);
+                    }
+                }
+            });
+            break;
+        case PixelFormat::YUV420:
+        case PixelFormat::YUV444:
+        case PixelFormat::YUV400:
+            // Planar BT.601 limited range YCbCr to RGB, 8-bit fixed point
+            parallelFor(h, [&](uint32_t begin, uint32_t end) {
+                const bool mono = layout.format == PixelFormat::YUV400;
+                const bool subsampled = layout.format == PixelFormat::YUV420;
+                const uint32_t chromaW = subsampled ? (w + 1) / 2 : w;
+                const uint32_t chromaH = mono ? 0 : (subsampled ? (h + 1) / 2 : h);
+                const uint8_t* yPlane = frameData;
+                const uint8_t* uPlane = frameData + size_t(w) * h;
+                const uint8_t* vPlane = uPlane + size_t(chromaW) * chromaH;
+                for (uint32_t y = begin; y < end; y++) {
+                    for (uint32_t x = 0; x < w; x++) {
+                        size_t chromaIdx = subsampled ? size_t(y / 2) * chromaW + x / 2 : size_t(y) * w + x;
+                        int c = 298 * (int(yPlane[size_t(y) * w + x]) - 16);
+                        int d = mono ? 0 : int(uPlane[chromaIdx]) - 128;
+                        int e = mono ? 0 : int(vPlane[chromaIdx]) - 128;
+                        uint8_t* out = &outData[(size_t(y) * w + x) * 3];
+                        out[0] = uint8_t(std::clamp((c + 409 * e + 128) >> 8, 0, 255));
+                        out[1] = uint8_t(std::clamp((c - 100 * d - 208 * e + 128) >> 8, 0, 255));
+                        out[2] = uint8_t(std::clamp((c + 516 * d + 128) >> 8, 0, 255));
+                    }
+                }
+            });
+            break;
+    }
+}
+
+void Project::updateMetrics() {
+    auto start = std::chrono::steady_clock::now();
+    res::Image* refImg = res::get<res::Image>("reference");
+    const uint8_t* refData = refImg->getData();
+    uint32_t w = refImg->getWidth();
+    uint32_t h = refImg->getHeight();
+    uint32_t ch = refImg->getChannels();
+
+    // The reference Lab values are shared by all stages
+    TrackedVector<atta::vec3> refLab(size_t(w / DELTA_E_STRIDE) * (h / DELTA_E_STRIDE));
+    parallelFor(h / DELTA_E_STRIDE, [&](uint32_t yBegin, uint32_t yEnd) {
+        for (uint32_t y = yBegin; y < yEnd; y++)
+            for (uint32_t x = 0; x < w / DELTA_E_STRIDE; x++)
+                refLab[size_t(y) * (w / DELTA_E_STRIDE) + x] = rgbToLab(&refData[(size_t(y) * DELTA_E_STRIDE * w + x * DELTA_E_STRIDE) * ch]);
+    });
+
+    _stageMetrics.clear();
+    for (const std::string& name : _stageNames) {
+        const uint8_t* data = res::get<res::Image>(name)->getData();
+        _stageMetrics.push_back({name, computeMetrics(refData, refLab.data(), data, w, h, ch)});
+    }
+    _metricsTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Report pipeline outputs
+    for (const auto& [name, metrics] : _stageMetrics)
+        if (name == "deg_output" || name == "pro_output")
+            LOG_INFO("Metrics", "$0: PSNR $1/$2/$3 dB, SSIM $4, ΔE00 $5", name, metrics.psnr.x, metrics.psnr.y, metrics.psnr.z, metrics.ssim,
+                     metrics.deltaE);
+    LOG_INFO("Metrics", "Metrics took $0 ms (pipeline took $1 ms)", _metricsTime, _pipelineTime);
+}
+
+Project::ImageMetrics Project::computeMetrics(const uint8_t* refData, const atta::vec3* refLab, const uint8_t* data, uint32_t w, uint32_t h,
+                                              uint32_t ch) const {
+    constexpr uint32_t BAND_ROWS = 32;
+    constexpr uint32_t WIN = SSIM_WINDOW;
+    constexpr float C1 = (0.01f * 255.0f) * (0.01f * 255.0f);
+    constexpr float C2 = (0.03f * 255.0f) * (0.03f * 255.0f);
+    constexpr float N = float(WIN * WIN);
+    const uint32_t labW = w / DELTA_E_STRIDE;
+    const uint32_t labH = h / DELTA_E_STRIDE;
+    const uint32_t ssimW = w >= WIN ? w - WIN + 1 : 0; // Number of window positions per row
+    const uint32_t ssimH = h >= WIN ? h - WIN + 1 : 0;
+
+    std::mutex mutex;
+    std::array<uint64_t, 4> squaredError{};
+    double ssimSum = 0.0;
+    double deltaESum = 0.0;
+
+    // Each band accumulates the squared error of its rows, the SSIM of the windows starting at its rows, and the ΔE of its sampled rows
+    parallelFor((h + BAND_ROWS - 1) / BAND_ROWS, [&](uint32_t bandBegin, uint32_t bandEnd) {
+        std::array<uint64_t, 4> localSquaredError{};
+        double localSsim = 0.0;
+        double localDeltaE = 0.0;
+
+        // Luma rows and sliding window sums
+        TrackedVector<uint8_t> lumaRef(w), luma(w);
+        TrackedVector<uint32_t> rowX(size_t(BAND_ROWS + WIN) * w), rowY(rowX.size()), rowXX(rowX.size()), rowYY(rowX.size()), rowXY(rowX.size());
+        TrackedVector<uint32_t> sumX(w), sumY(w), sumXX(w), sumYY(w), sumXY(w);
+
+        for (uint32_t band = bandBegin; band < bandEnd; band++) {
+            const uint32_t y0 = band * BAND_ROWS;
+            const uint32_t y1 = std::min(h, y0 + BAND_ROWS);
+
+            // PSNR
+            for (uint32_t y = y0; y < y1; y++) {
+                const uint8_t* refRow = &refData[size_t(y) * w * ch];
+                const uint8_t* row = &data[size_t(y) * w * ch];
+                for (uint32_t c = 0; c < std::min(ch, 4u); c++) {
+                    uint64_t sum = 0;
+                    for (uint32_t x = 0; x < w; x++) {
+                        int d = int(refRow[x * ch + c]) - int(row[x * ch + c]);
+                        sum += d * d;
+                    }
+                    localSquaredError[c] += sum;
+                }
+            }
+
+            // SSIM, window positions starting at rows [y0, min(y1, ssimH)). Rows are box-filtered horizontally, then a vertical sliding sum gives
+            // the window sums
+            const uint32_t ssimY1 = std::min(y1, ssimH);
+            if (y0 < ssimY1) {
+                const uint32_t numRows = ssimY1 - y0 + WIN - 1;
+                for (uint32_t r = 0; r < numRows; r++) {
+                    const uint8_t* refRow = &refData[size_t(y0 + r) * w * ch];
+                    const uint8_t* row = &data[size_t(y0 + r) * w * ch];
+                    for (uint32_t x = 0; x < w; x++) {
+                        lumaRef[x] = (77 * refRow[x * ch] + 150 * refRow[x * ch + 1] + 29 * refRow[x * ch + 2]) >> 8;
+                        luma[x] = (77 * row[x * ch] + 150 * row[x * ch + 1] + 29 * row[x * ch + 2]) >> 8;
+                    }
+                    uint32_t sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+                    for (uint32_t x = 0; x < w; x++) {
+                        uint32_t a = lumaRef[x], b = luma[x];
+                        sx += a, sy += b, sxx += a * a, syy += b * b, sxy += a * b;
+                        if (x >= WIN) {
+                            uint32_t ao = lumaRef[x - WIN], bo = luma[x - WIN];
+                            sx -= ao, sy -= bo, sxx -= ao * ao, syy -= bo * bo, sxy -= ao * bo;
+                        }
+                        if (x + 1 >= WIN) {
+                            size_t i = size_t(r) * w + x + 1 - WIN;
+                            rowX[i] = sx, rowY[i] = sy, rowXX[i] = sxx, rowYY[i] = syy, rowXY[i] = sxy;
+                        }
+                    }
+                }
+
+                std::fill(sumX.begin(), sumX.end(), 0u);
+                std::fill(sumY.begin(), sumY.end(), 0u);
+                std::fill(sumXX.begin(), sumXX.end(), 0u);
+                std::fill(sumYY.begin(), sumYY.end(), 0u);
+                std::fill(sumXY.begin(), sumXY.end(), 0u);
+                for (uint32_t r = 0; r < numRows; r++) {
+                    for (uint32_t x = 0; x < ssimW; x++) {
+                        size_t i = size_t(r) * w + x;
+                        sumX[x] += rowX[i], sumY[x] += rowY[i], sumXX[x] += rowXX[i], sumYY[x] += rowYY[i], sumXY[x] += rowXY[i];
+                    }
+                    if (r + 1 < WIN)
+                        continue;
+                    for (uint32_t x = 0; x < ssimW; x++) {
+                        float muX = sumX[x] / N;
+                        float muY = sumY[x] / N;
+                        float varX = sumXX[x] / N - muX * muX;
+                        float varY = sumYY[x] / N - muY * muY;
+                        float cov = sumXY[x] / N - muX * muY;
+                        localSsim += ((2.0f * muX * muY + C1) * (2.0f * cov + C2)) / ((muX * muX + muY * muY + C1) * (varX + varY + C2));
+                    }
+                    for (uint32_t x = 0; x < ssimW; x++) {
+                        size_t i = size_t(r + 1 - WIN) * w + x;
+                        sumX[x] -= rowX[i], sumY[x] -= rowY[i], sumXX[x] -= rowXX[i], sumYY[x] -= rowYY[i], sumXY[x] -= rowXY[i];
+                    }
+                }
+            }
+
+            // CIEDE2000 on the sampled grid
+            for (uint32_t ly = (y0 + DELTA_E_STRIDE - 1) / DELTA_E_STRIDE; ly < std::min(labH, (y1 + DELTA_E_STRIDE - 1) / DELTA_E_STRIDE); ly++) {
+                for (uint32_t lx = 0; lx < labW; lx++) {
+                    size_t idx = (size_t(ly) * DELTA_E_STRIDE * w + lx * DELTA_E_STRIDE) * ch;
+                    // Identical pixels have no color difference
+                    if (data[idx] == refData[idx] && data[idx + 1] == refData[idx + 1] && data[idx + 2] == refData[idx + 2])
+                        continue;
+                    localDeltaE += ciede2000(refLab[size_t(ly) * labW + lx], rgbToLab(&data[idx]));
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t c = 0; c < 4; c++)
+            squaredError[c] += localSquaredError[c];
+        ssimSum += localSsim;
+        deltaESum += localDeltaE;
+    });
+
+    ImageMetrics metrics;
+    for (uint32_t c = 0; c < 3; c++) {
+        double mse = double(squaredError[c]) / (double(w) * h);
+        metrics.psnr[c] = mse > 0.0 ? float(10.0 * std::log10(255.0 * 255.0 / mse)) : std::numeric_limits<float>::infinity();
+    }
+    metrics.ssim = ssimW > 0 && ssimH > 0 ? float(ssimSum / (double(ssimW) * ssimH)) : 1.0f;
+    metrics.deltaE = labW > 0 && labH > 0 ? float(deltaESum / (double(labW) * labH)) : 0.0f;
+    return metrics;
+}
+
+atta::vec3 Project::rgbToLab(const uint8_t* pixel) {
+    // sRGB to linear lookup table
+    static const std::array<float, 256> srgbToLinear = [] {
+        std::array<float, 256> table;
+        for (int i = 0; i < 256; i++) {
+            float v = i / 255.0f;
+            table[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+    float r = srgbToLinear[pixel[0]];
+    float g = srgbToLinear[pixel[1]];
+    float b = srgbToLinear[pixel[2]];
+
+    // Linear sRGB to XYZ, normalized by the D65 white point
+    float x = (0.4124564f * r + 0.3575761f * g + 0.1804375f * b) / 0.95047f;
+    float y = (0.2126729f * r + 0.7151522f * g + 0.0721750f * b);
+    float z = (0.0193339f * r + 0.1191920f * g + 0.9503041f * b) / 1.08883f;
+
+    auto f = [](float t) { return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f; };
+    float fx = f(x), fy = f(y), fz = f(z);
+    return atta::vec3(116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz));
+}
+
+float Project::ciede2000(const atta::vec3& lab1, const atta::vec3& lab2) {
+    constexpr float PI = 3.14159265f;
+    constexpr float DEG = PI / 180.0f;
+    const float pow25_7 = 6103515625.0f; // 25^7
+
+    float c1 = std::sqrt(lab1.y * lab1.y + lab1.z * lab1.z);
+    float c2 = std::sqrt(lab2.y * lab2.y + lab2.z * lab2.z);
+    float cMean = (c1 + c2) * 0.5f;
+    float cMean7 = std::pow(cMean, 7.0f);
+    float g = 0.5f * (1.0f - std::sqrt(cMean7 / (cMean7 + pow25_7)));
+
+    float a1 = (1.0f + g) * lab1.y;
+    float a2 = (1.0f + g) * lab2.y;
+    float c1p = std::sqrt(a1 * a1 + lab1.z * lab1.z);
+    float c2p = std::sqrt(a2 * a2 + lab2.z * lab2.z);
+    float h1p = (a1 == 0.0f && lab1.z == 0.0f) ? 0.0f : std::atan2(lab1.z, a1);
+    float h2p = (a2 == 0.0f && lab2.z == 0.0f) ? 0.0f : std::atan2(lab2.z, a2);
+    if (h1p < 0.0f)
+        h1p += 2.0f * PI;
+    if (h2p < 0.0f)
+        h2p += 2.0f * PI;
+
+    float dL = lab2.x - lab1.x;
+    float dC = c2p - c1p;
+    float dh = 0.0f;
+    if (c1p * c2p != 0.0f) {
+        dh = h2p - h1p;
+        if (dh > PI)
+            dh -= 2.0f * PI;
+        else if (dh < -PI)
+            dh += 2.0f * PI;
+    }
+    float dH = 2.0f * std::sqrt(c1p * c2p) * std::sin(dh * 0.5f);
+
+    float lMean = (lab1.x + lab2.x) * 0.5f;
+    float cMeanP = (c1p + c2p) * 0.5f;
+    float hMean = h1p + h2p;
+    if (c1p * c2p != 0.0f) {
+        if (std::abs(h1p - h2p) > PI)
+            hMean += (hMean < 2.0f * PI) ? 2.0f * PI : -2.0f * PI;
+        hMean *= 0.5f;
+    }
+
+    float t = 1.0f - 0.17f * std::cos(hMean - 30.0f * DEG) + 0.24f * std::cos(2.0f * hMean) + 0.32f * std::cos(3.0f * hMean + 6.0f * DEG) -
+              0.20f * std::cos(4.0f * hMean - 63.0f * DEG);
+    float dTheta = 30.0f * DEG * std::exp(-std::pow((hMean / DEG - 275.0f) / 25.0f, 2.0f));
+    float cMeanP7 = std::pow(cMeanP, 7.0f);
+    float rc = 2.0f * std::sqrt(cMeanP7 / (cMeanP7 + pow25_7));
+    float l50 = (lMean - 50.0f) * (lMean - 50.0f);
+    float sl = 1.0f + 0.015f * l50 / std::sqrt(20.0f + l50);
+    float sc = 1.0f + 0.045f * cMeanP;
+    float sh = 1.0f + 0.015f * cMeanP * t;
+    float rt = -std::sin(2.0f * dTheta) * rc;
+
+    float tl = dL / sl;
+    float tc = dC / sc;
+    float th = dH / sh;
+    return std::sqrt(tl * tl + tc * tc + th * th + rt * tc * th);
+}
+
+Project::AllocationCount Project::allocationCount() {
+    return {_allocationCount.load(std::memory_order_relaxed), _allocationBytes.load(std::memory_order_relaxed)};
+}
+
+std::vector<Project::MemoryEntry> Project::memoryFootprint() const {
+    std::vector<MemoryEntry> entries;
+
+    // Reference, stage and scaled output images, each with its thumbnail (if any)
+    std::vector<std::string> images = {"reference"};
+    images.insert(images.end(), _stageNames.begin(), _stageNames.end());
+    for (const ScalerOutput& output : _scalerOutputs)
+        if (!output.name.empty())
+            images.push_back("pro_output_" + output.name);
+    for (const std::string& name : images)
+        for (const std::string& image : {name, name + "_thumb"})
+            if (res::Image* img = res::get<res::Image>(image))
+                entries.push_back({image, image == name ? "image" : "thumbnail", size_t(img->getWidth()) * img->getHeight() * img->getChannels()});
+
+    // Frame buffers, tables and caches
+    entries.push_back({"stage_frames", "buffer", _stageFrames[0].capacity() + _stageFrames[1].capacity()});
+    entries.push_back({"input_staging", "buffer", _inputStaging.capacity() + _inputPending.capacity()});
+    entries.push_back({"dead_pixels", "table", _camera.deadPixels.capacity() * sizeof(uint64_t)});
+    entries.push_back({"stage_plans", "table", sizeof(StagePlans)});
+    entries.push_back({"color_lut", "table", _colorLut.capacity() * sizeof(uint16_t) + _colorLutOutput.capacity() + sizeof(_colorCurve)});
+    entries.push_back({"lens_shading_mesh", "table", _camera.calibration.lensShading.capacity() * sizeof(atta::vec3)});
+    for (const ScalerOutput& output : _scalerOutputs) {
+        const std::string name = "scaler_" + (output.name.empty() ? "thumbnail" : output.name);
+        entries.push_back({name, "buffer", output.data[0].capacity() + output.data[1].capacity()});
+        size_t tableSize = 0;
+        for (const PolyphaseFilter* filter : {&output.filterX, &output.filterY})
+            tableSize += filter->coeffs.capacity() * sizeof(float) + filter->start.capacity() * sizeof(int32_t) +
+                         filter->phase.capacity() * sizeof(uint32_t);
+        entries.push_back({name + "_filters", "table", tableSize});
+    }
+    entries.push_back({"input_frame_index", "cache", _inputFrames.capacity() * sizeof(size_t)});
+    entries.push_back({"input_file", "mapped", _inputFile.size});
+    return entries;
+}
+
+void Project::logMemoryReport() const {
+    for (const MemoryEntry& entry : _memoryFootprint)
+        LOG_INFO("Memory", "[w]$0[] ($1): $2 KB", entry.name, entry.kind, entry.bytes / 1e3);
+    for (const auto& [name, allocations] : _stageAllocations)
+        LOG_INFO("Memory", "[w]$0[]: $1 allocations ($2 KB)", name, allocations.count, allocations.bytes / 1e3);
+    LOG_INFO("Memory", "Peak resident memory $0 MB ($1), resident memory $2 MB", _peakResidentMemory / 1e6,
+             _peakResidentMemoryReset ? "last reprocess" : "since startup", residentMemory(false) / 1e6);
+}
+
+bool Project::resetPeakResidentMemory() {
+    // Writing 5 to clear_refs resets the peak resident set size (VmHWM) of the process to the current resident set size
+    int fd = ::open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0)
+        return false;
+    bool reset = ::write(fd, "5", 1) == 1;
+    ::close(fd);
+    return reset;
+}
+
+size_t Project::residentMemory(bool peak) {
+    std::ifstream status("/proc/self/status");
+    const std::string field = peak ? "VmHWM:" : "VmRSS:";
+    std::string line;
+    while (std::getline(status, line))
+        if (line.compare(0, field.size(), field) == 0)
+            return std::stoull(line.substr(field.size())) * 1024; // Reported in kB
+    if (!peak)
+        return 0;
+
+    // Without procfs (macOS) only the peak since startup is available, reported in bytes
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return size_t(usage.ru_maxrss);
+}
+
+atta::vec3 Project::tempToGain(float temp) {
+    // Clamp temperature to the table's range
+    if (temp <= TEMPERATURE_GAIN_MIN)
+        return _temperatureGainMap[0];
+    if (temp >= TEMPERATURE_GAIN_MAX)
+        return _temperatureGainMap[TEMPERATURE_GAIN_COUNT - 1];
+
+    // Calculate the fractional index in the table
+    float fractionalIndex = (temp - TEMPERATURE_GAIN_MIN) / TEMPERATURE_GAIN_STEP;
+
+    uint32_t index1 = static_cast<uint32_t>(fractionalIndex);
+    uint32_t index2 = index1 + 1;
+
+    // Basic bounds check (should be mostly covered by temp clamping)
+    if (index1 >= TEMPERATURE_GAIN_COUNT)
+        index1 = TEMPERATURE_GAIN_COUNT - 1;
+    if (index2 >= TEMPERATURE_GAIN_COUNT)
+        index2 = TEMPERATURE_GAIN_COUNT - 1;
+
+    const atta::vec3& gains1 = _temperatureGainMap[index1];
+    const atta::vec3& gains2 = _temperatureGainMap[index2];
+
+    // Calculate the interpolation factor (t)
+    float t = fractionalIndex - static_cast<float>(index1);
+
+    // Linear interpolation
+    return (1.0f - t) * gains1 + t * gains2;
+}
+
+uint32_t Project::randomHash(uint32_t key, uint32_t counter) {
+    // Integer hash with good avalanche (lowbias32). Only 32-bit operations, so loops over counters vectorize
+    uint32_t x = counter ^ (key * 0x9e3779b9u);
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float Project::randomNormal(uint32_t key, uint32_t counter) {
+    // Sum of four uniform variables (Irwin-Hall) scaled to unit variance. It is branchless and close enough to a normal distribution for noise
+    // simulation (tails are truncated at ±3.46)
+    uint32_t a = randomHash(key, 2 * counter);
+    uint32_t b = randomHash(key, 2 * counter + 1);
+    float sum = float((a & 0xffff) + (a >> 16) + (b & 0xffff) + (b >> 16)) * (1.0f / 65536.0f);
+    return (sum - 2.0f) * 1.7320508f;
+}
+
+void Project::parallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& func) {
+    // Calls from a worker thread run serially, the outer loop already uses all cores (e.g. stages running on tiles in parallel)
+    uint32_t numThreads = std::min(count, std::max(1u, std::thread::hardware_concurrency()));
+    if (numThreads <= 1 || parallelWorker) {
+        func(0, count);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < numThreads; t++) {
+        // Bounds in 64 bits, count * t overflows for large counts
+        const uint32_t begin = uint32_t(uint64_t(count) * t / numThreads);
+        const uint32_t end = uint32_t(uint64_t(count) * (t + 1) / numThreads);
+        threads.emplace_back([&func, begin, end]() {
+            parallelWorker = true;
+            func(begin, end);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void Project::parallelForPixels(size_t pixels, const std::function<void(size_t begin, size_t end)>& func) {
+    // Blocks of pixels, so frames with more than 2^32 pixels (or values) are split without truncating the count
+    constexpr size_t BLOCK = 4096;
+    parallelFor(uint32_t((pixels + BLOCK - 1) / BLOCK), [&](uint32_t begin, uint32_t end) {
+        func(size_t(begin) * BLOCK, std::min(size_t(end) * BLOCK, pixels));
+    });
+}
+
+void Project::runSerial(const std::function<void()>& func) {
+    const bool wasWorker = parallelWorker;
+    parallelWorker = true;
+    func();
+    parallelWorker = wasWorker;
+}
+
+void Project::runWithCamera(const CameraModule& camera, const std::function<void()>& func) {
+    const CameraModule* previous = _threadCamera;
+    _threadCamera = &camera;
+    func();
+    _threadCamera = previous;
+}
 
+template <Project::Interpolation MODE, uint32_t CH, typename Step>
+std::array<float, CH> Project::samplePixel(const uint8_t* data, uint32_t w, uint32_t h, Step step, float x, float y, size_t channelStride) {
+    std::array<float, CH> result;
+    if constexpr (MODE == Interpolation::NEAREST) {
+        // Convert to integer coordinates and clamp
+        uint32_t sx = std::clamp(int(std::round(x)), 0, int(w) - 1);
+        uint32_t sy = std::clamp(int(std::round(y)), 0, int(h) - 1);
+        const uint8_t* pixel = &data[(size_t(sy) * w + sx) * step];
+        for (uint32_t c = 0; c < CH; c++)
+            result[c] = pixel[c * channelStride];
+    } else {
+        // Determine the integer coordinates of the top-left pixel of the 2x2 grid and the fractional parts for interpolation
+        int x0 = static_cast<int>(std::floor(x));
+        int y0 = static_cast<int>(std::floor(y));
+        float fx = x - static_cast<float>(x0);
+        float fy = y - static_cast<float>(y0);
+
+        // Clamp the grid coordinates to be within image bounds
+        size_t cx0 = std::clamp(x0, 0, static_cast<int>(w) - 1);
+        size_t cx1 = std::clamp(x0 + 1, 0, static_cast<int>(w) - 1);
+        size_t cy0 = std::clamp(y0, 0, static_cast<int>(h) - 1);
+        size_t cy1 = std::clamp(y0 + 1, 0, static_cast<int>(h) - 1);
+        const uint8_t* q00 = &data[(cy0 * w + cx0) * step]; // Top-left
+        const uint8_t* q10 = &data[(cy0 * w + cx1) * step]; // Top-right
+        const uint8_t* q01 = &data[(cy1 * w + cx0) * step]; // Bottom-left
+        const uint8_t* q11 = &data[(cy1 * w + cx1) * step]; // Bottom-right
+
+        // Interpolate along the x-axis for the top and bottom rows, then along the y-axis
+        for (uint32_t c = 0; c < CH; c++) {
+            const size_t i = c * channelStride;
+            float p0 = static_cast<float>(q00[i]) * (1.0f - fx) + static_cast<float>(q10[i]) * fx;
+            float p1 = static_cast<float>(q01[i]) * (1.0f - fx) + static_cast<float>(q11[i]) * fx;
+            result[c] = p0 * (1.0f - fy) + p1 * fy;
+        }
+    }
     return result;
 }
+
+template <Project::Interpolation MODE, typename Step>
+float Project::sampleChannel(const uint8_t* data, uint32_t w, uint32_t h, Step step, float x, float y) {
+    return samplePixel<MODE, 1>(data, w, h, step, x, y, 0)[0];
+}
+
+void Project::interleavedToPlanar(const uint8_t* inData, uint8_t* outData, size_t pixels, uint32_t ch) {
+    parallelForPixels(pixels, [&](size_t begin, size_t end) {
+        for (uint32_t c = 0; c < ch; c++) {
+            uint8_t* plane = &outData[c * pixels];
+            for (size_t i = begin; i < end; i++)
+                plane[i] = inData[i * ch + c];
+        }
+    });
+}
+
+void Project::planarToInterleaved(const uint8_t* inData, uint8_t* outData, size_t pixels, uint32_t ch) {
+    parallelForPixels(pixels, [&](size_t begin, size_t end) {
+        for (uint32_t c = 0; c < ch; c++) {
+            const uint8_t* plane = &inData[c * pixels];
+            for (size_t i = begin; i < end; i++)
+                outData[i * ch + c] = plane[i];
+        }
+    });
+}
+
+void Project::imageToFrame(const uint8_t* imageData, uint32_t imageCh, uint8_t* frameData, uint32_t ch, size_t pixels, bool planar) {
+    if (ch == imageCh) {
+        if (planar)
+            interleavedToPlanar(imageData, frameData, pixels, ch);
+        else
+            std::memcpy(frameData, imageData, pixels * ch);
+        return;
+    }
+    const size_t step = planar ? 1 : ch;
+    const size_t channelStride = planar ? pixels : 1;
+    parallelForPixels(pixels, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const uint8_t* pixel = &imageData[i * imageCh];
+            uint8_t* out = &frameData[i * step];
+            std::array<uint8_t, 4> rgba = {pixel[0], pixel[0], pixel[0], 255};
+            if (imageCh >= 3)
+                rgba = {pixel[0], pixel[1], pixel[2], imageCh == 4 ? pixel[3] : uint8_t(255)};
+            if (ch == 1)
+                out[0] = (77 * rgba[0] + 150 * rgba[1] + 29 * rgba[2]) >> 8; // BT.601 luma
+            else
+                for (uint32_t c = 0; c < ch; c++)
+                    out[c * channelStride] = rgba[c];
+        }
+    });
+}
+
+void Project::frameToImage(const uint8_t* frameData, uint32_t ch, bool planar, uint8_t* imageData, uint32_t imageCh, size_t pixels) {
+    if (ch == imageCh) {
+        if (planar)
+            planarToInterleaved(frameData, imageData, pixels, ch);
+        else
+            std::memcpy(imageData, frameData, pixels * ch);
+        return;
+    }
+    const size_t step = planar ? 1 : ch;
+    const size_t channelStride = planar ? pixels : 1;
+    parallelForPixels(pixels, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const uint8_t* pixel = &frameData[i * step];
+            uint8_t* out = &imageData[i * imageCh];
+            std::array<uint8_t, 4> rgba = {pixel[0], pixel[0], pixel[0], 255};
+            if (ch >= 3)
+                rgba = {pixel[0], pixel[channelStride], pixel[2 * channelStride], ch == 4 ? pixel[3 * channelStride] : uint8_t(255)};
+            if (imageCh == 1)
+                out[0] = (77 * rgba[0] + 150 * rgba[1] + 29 * rgba[2]) >> 8; // BT.601 luma
+            else
+                for (uint32_t c = 0; c < imageCh; c++)
+                    out[c] = rgba[c];
+        }
+    });
+}
+
+uint64_t Project::hashData(const uint8_t* data, size_t size) {
+    // FNV-1a variant that consumes 8 bytes per step
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    return hash;
+}
+
+void Project::downscaleImage(const uint8_t* inData, uint32_t inW, uint32_t inH, uint8_t* outData, uint32_t outW, uint32_t outH, uint32_t ch) {
+    // Box filter, each output pixel is the average of the input pixels it covers
+    for (uint32_t oy = 0; oy < outH; oy++) {
+        uint32_t y0 = oy * inH / outH;
+        uint32_t y1 = std::max(y0 + 1, (oy + 1) * inH / outH);
+        for (uint32_t ox = 0; ox < outW; ox++) {
+            uint32_t x0 = ox * inW / outW;
+            uint32_t x1 = std::max(x0 + 1, (ox + 1) * inW / outW);
+
+            for (uint32_t c = 0; c < ch; c++) {
+                uint32_t sum = 0;
+                for (uint32_t y = y0; y < y1; y++)
+                    for (uint32_t x = x0; x < x1; x++)
+                        sum += inData[(y * inW + x) * ch + c];
+                outData[(oy * outW + ox) * ch + c] = sum / ((y1 - y0) * (x1 - x0));
+            }
+        }
+    }
+}
@@ -7,6 +7,10 @@
 #ifndef PROJECT_SCRIPT_H
 #define PROJECT_SCRIPT_H
 #include <atta/script/projectScript.h>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <tuple>
 
 class Project : public scr::ProjectScript {
   public:
@@ -21,27 +25,362 @@ class Project : public scr::ProjectScript {
     int _selectedImage = 0;
     bool _shouldReprocess = true;
 
+    // Rectangle of the frame (in frame pixel coordinates)
+    struct Region {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t w = 0;
+        uint32_t h = 0;
+        bool contains(const Region& other) const {
+            return other.x >= x && other.y >= y && other.x + other.w <= x + w && other.y + other.h <= y + h;
+        }
+    };
+    // Part of the frame processed by a stage call. The input buffer holds the pixels of tile.in and the output buffer holds the pixels of
+    // tile.out, so a stage can run on the whole frame (both regions are the frame) or on a tile with its halo. Stage code works with frame
+    // coordinates and uses these helpers to index the buffers. Buffers are either interleaved (the channels of each pixel are together) or
+    // planar (one plane per channel), so the stages only access channel c of a pixel through the index, step and channel stride
+    struct Tile {
+        Region in;
+        Region out;
+        bool planar = false;
+        uint32_t step(uint32_t ch) const { return planar ? 1 : ch; } // Distance between horizontally adjacent values of a channel
+        size_t inChannelStride() const { return planar ? size_t(in.w) * in.h : 1; }    // Distance between the channels of an input pixel
+        size_t outChannelStride() const { return planar ? size_t(out.w) * out.h : 1; } // Distance between the channels of an output pixel
+        size_t inIndex(uint32_t x, uint32_t y, uint32_t ch, uint32_t c = 0) const {
+            return (size_t(y - in.y) * in.w + (x - in.x)) * step(ch) + c * inChannelStride();
+        }
+        size_t outIndex(uint32_t x, uint32_t y, uint32_t ch, uint32_t c = 0) const {
+            return (size_t(y - out.y) * out.w + (x - out.x)) * step(ch) + c * outChannelStride();
+        }
+    };
+    static Tile fullFrame(uint32_t w, uint32_t h, bool planar = false);
+    static Region growRegion(const Region& region, uint32_t halo, uint32_t w, uint32_t h); // Grow by halo pixels, clamped to the frame
+
     // Degradation pipeline
-    void degWhiteBalanceError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void degLensDistortion(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void degColorShadingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void degChromaticAberrationError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void degVignettingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void degBlackLevelOffset(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch);
-    void degDeadPixelInjection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch);
+    void degWhiteBalanceError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void degLensDistortion(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void degColorShadingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void degChromaticAberrationError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void degVignettingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void degSensorNoise(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void degBlackLevelOffset(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void degDeadPixelInjection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
 
     // Image processing pipeline
-    void proDeadPixelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void proBlackLevelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void proVignettingCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void proChromaticAberrationCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void proColorShadingCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void proLensCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void proWhiteBalanceCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-    void proWhiteBalanceCorrectionAuto(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch) const;
-
-    static atta::vec3 nearestNeighborSampling(const uint8_t* data, uint32_t w, uint32_t h, uint32_t ch, float x, float y);
-    static atta::vec3 bilinearSampling(const uint8_t* data, uint32_t w, uint32_t h, uint32_t ch, float x, float y);
+    void proDeadPixelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void proBlackLevelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void proNoiseReduction(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void proLensShadingCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void proChromaticAberrationCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void proLensCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void proWhiteBalanceCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void proWhiteBalanceCorrectionAuto(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void proColorCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+    void copyStage(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch, const Tile& tile) const;
+
+    // Per-frame stage state (optical black measurements, dead pixel list, stage plans and color LUT). It is generated before running the
+    // stages so the stages only read member state, and any tile can be processed from any thread. Everything but the color LUT belongs to a
+    // camera module, and the stages read the module of the calling thread (camera())
+    struct CameraModule;
+    void prepareStages(uint32_t w, uint32_t h, uint32_t ch); // Prepare the current camera module and the color LUT
+    void prepareCamera(CameraModule& camera, uint32_t w, uint32_t h, uint32_t ch) const;
+    void generateObPixels(CameraModule& camera) const;
+    void generateDeadPixels(CameraModule& camera, uint32_t w, uint32_t h, uint32_t ch) const;
+    void compileStagePlans(CameraModule& camera, uint32_t w, uint32_t h) const;
+    void forEachDeadPixel(const Region& region, uint32_t w, uint32_t ch, const std::function<void(uint32_t x, uint32_t y, uint32_t c)>& func) const;
+    const CameraModule& camera() const { return _threadCamera != nullptr ? *_threadCamera : _camera; }
+    // Run func in the calling thread, with the stages reading camera instead of the current camera module
+    static void runWithCamera(const CameraModule& camera, const std::function<void()>& func);
+
+    // Halo of each stage: maximum distance (pixels) between an output pixel of the region and the input pixels it reads. Warp stages use
+    // their maximum displacement inside the region
+    uint32_t degLensHalo(const Region& region, uint32_t w, uint32_t h) const;
+    uint32_t degChromaticAberrationHalo(const Region& region, uint32_t w, uint32_t h) const;
+    uint32_t deadPixelHalo(const Region& region, uint32_t w, uint32_t h) const;
+    uint32_t noiseReductionHalo(const Region& region, uint32_t w, uint32_t h) const;
+    uint32_t proChromaticAberrationHalo(const Region& region, uint32_t w, uint32_t h) const;
+    uint32_t proLensHalo(const Region& region, uint32_t w, uint32_t h) const;
+    static float maxRadialDisplacement(const Region& region, uint32_t w, uint32_t h, const std::function<float(float r)>& sourceRadius);
+
+    // Pipeline stages in order, each stage reads the output of the previous one and writes the stage image with its name
+    using StageFunc = void (Project::*)(const uint8_t*, uint8_t*, uint32_t, uint32_t, uint32_t, const Tile&) const;
+    using HaloFunc = uint32_t (Project::*)(const Region&, uint32_t, uint32_t) const;
+    struct Stage {
+        std::string name;
+        StageFunc func;
+        HaloFunc halo; // nullptr for point-wise stages
+    };
+    std::vector<Stage> _stages;
+
+    // Noise reduction
+    static void bilateralGridDenoise(const uint8_t* inData, uint8_t* outData, uint32_t ch, const Tile& tile, float strength, int quality);
+    static void nonLocalMeansDenoise(const uint8_t* inData, uint8_t* outData, uint32_t ch, const Tile& tile, float strength, int quality);
+    void benchmarkNoiseReduction();
+
+    // Scaler
+    struct PolyphaseFilter;
+    static PolyphaseFilter polyphaseFilter(uint32_t inSize, uint32_t outSize);
+    void runScaler(const uint8_t* inData, uint32_t w, uint32_t h, uint32_t ch, bool planar); // Scale the frame to every output size
+    // Run the stages from firstStage on every scaled output, then update the output images and the thumbnails of these stages
+    void processScalerOutputs(size_t firstStage, uint32_t ch, bool planar);
+
+    // Color correction
+    void buildColorLut();
+    bool loadColorLut(const fs::path& path);
+    float applyToneCurve(float value) const;
+
+    // Calibration
+    struct CalibrationProfile;
+    CalibrationProfile correctionProfile() const { return correctionProfile(camera()); }
+    CalibrationProfile correctionProfile(const CameraModule& camera) const; // Calibrated or ideal profile of the camera module
+    static atta::vec3 radialShadingGain(const CalibrationProfile& profile, float r); // Correction gain of the radial profile at radius r
+    void runCalibration();
+    void captureCalibrationImage(const uint8_t* sceneData, uint8_t* outData, uint32_t w, uint32_t h, uint32_t ch);
+    void calibrateShading(const uint8_t* flatData, uint32_t w, uint32_t h, uint32_t ch, CalibrationProfile& profile) const;
+    void calibrateChromaticAberration(const uint8_t* gridData, uint32_t w, uint32_t h, uint32_t ch, CalibrationProfile& profile) const;
+    bool saveCalibrationProfile(const fs::path& path) const;
+    bool loadCalibrationProfile(const fs::path& path, CameraModule& camera) const; // Load the calibration profile of the camera module
+    static bool solveLinearSystem(std::vector<double> a, std::vector<double> b, uint32_t n, std::vector<double>& x);
+
+    // Equivalence harness
+    struct EquivalenceVariant;
+    struct ReferenceStage;
+    std::vector<EquivalenceVariant> equivalenceVariants();
+    static std::vector<ReferenceStage> referenceStages();
+    void runEquivalenceHarness();
+    // RGB output of every reference stage, each one reading the output of the previous one (chained) or inData
+    std::vector<std::vector<uint8_t>> runReferencePipeline(const uint8_t* inData, uint32_t w, uint32_t h, bool chained = true);
+    // RGB output of every stage, each one reading the output of the previous one (chained) or inData
+    std::vector<std::vector<uint8_t>> runStagePipeline(const uint8_t* inData, uint32_t w, uint32_t h, bool chained = true);
+    uint32_t checkGoldenChecksums(const std::vector<std::pair<std::string, uint64_t>>& checksums, const fs::path& path, bool update) const;
+    static void generateSyntheticImage(uint32_t seed, uint32_t w, uint32_t h, uint8_t* outData); // RGB
+
+    // Reference stages: plain scalar implementations on full interleaved RGB frames, without plans, tables, tiles or threads. They are only
+    // used by the equivalence harness and are not changed when a stage is optimized
+    using ReferenceFunc = void (Project::*)(const uint8_t*, uint8_t*, uint32_t, uint32_t) const;
+    void refDegWhiteBalanceError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refDegLensDistortion(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refDegColorShadingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refDegChromaticAberrationError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refDegVignettingError(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refDegSensorNoise(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refDegBlackLevelOffset(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refDegDeadPixelInjection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refProDeadPixelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refProBlackLevelCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refProNoiseReduction(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refBilateralGridDenoise(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refNonLocalMeansDenoise(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refProLensShadingCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refProChromaticAberrationCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refProLensCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refProWhiteBalanceCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refProColorCorrection(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    void refCopy(const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h) const;
+    atta::vec3 refSampling(const uint8_t* data, uint32_t w, uint32_t h, float x, float y) const; // Nearest or bilinear (_interpolation)
+    bool refIsDeadPixel(uint32_t y, uint32_t i) const; // Whether color value i of row y is a failed photosite
+
+    // Out-of-core processing
+    struct MappedFile;
+    struct TiledImage;
+    bool processOutOfCore(const fs::path& inputPath, const fs::path& outputPath);
+
+    // Batch processing
+    bool processBatch(const fs::path& inputDir, const fs::path& outputDir);
+    // Run the stages up to lastStage on an RGB frame in place, using the arena buffers for the intermediate frames
+    void processBatchFrame(uint8_t* data, uint32_t w, uint32_t h, size_t lastStage, std::array<std::vector<uint8_t>, 2>& arena) const;
+
+    // Multi-stream processing
+    struct StreamContext;
+    bool processStreams(const std::vector<std::string>& streams, const fs::path& outputDir); // Each stream is "file" or "file, profile"
+
+    // Frame input
+    struct FrameLayout;
+    bool openInput(const fs::path& path); // Open an image, a multi-frame file (PPM/PGM, Y4M or raw) or a stream ("-" for stdin, or a FIFO)
+    enum class InputContainer;
+    // Detect the container of a mapped multi-frame file and append the offset of each complete frame (raw files use the raw layout)
+    InputContainer indexFrames(const MappedFile& file, bool raw, FrameLayout& layout, std::vector<size_t>& frames) const;
+    void closeInput();
+    bool readInputFrame();  // Read the current frame of the input into the reference image
+    bool readStreamFrame(); // Read the next frame of the input stream if data is available
+    bool readStreamBytes(uint8_t* data, size_t size);
+    bool readStreamLine(std::string& line);
+    void resizeFrame(uint32_t w, uint32_t h); // Resize the reference and stage images
+    static size_t parsePnmHeader(const uint8_t* data, size_t size, FrameLayout& layout); // Header size, 0 if incomplete or invalid
+    static bool parseY4mHeader(const std::string& header, FrameLayout& layout);
+    static void convertFrame(const uint8_t* frameData, const FrameLayout& layout, uint8_t* outData); // Convert a frame to RGB8
+
+    // Image quality metrics
+    struct ImageMetrics {
+        atta::vec3 psnr;     // Per-channel peak signal-to-noise ratio (dB)
+        float ssim = 0.0f;   // Mean structural similarity of the luma channel
+        float deltaE = 0.0f; // Mean CIEDE2000 color difference
+    };
+    ImageMetrics computeMetrics(const uint8_t* refData, const atta::vec3* refLab, const uint8_t* data, uint32_t w, uint32_t h, uint32_t ch) const;
+    void updateMetrics();
+    static atta::vec3 rgbToLab(const uint8_t* pixel);
+    static float ciede2000(const atta::vec3& lab1, const atta::vec3& lab2);
+
+    // Display
+    void createStageImage(const std::string& name, uint32_t w, uint32_t h);
+    void createThumbnail(const std::string& name); // Create the thumbnail, or resize it if the image size changed
+    void invalidateStages(const std::string& firstStage = ""); // Reprocess, with the outputs from firstStage on changed (all if empty)
+    void updateStageDisplay(const std::string& name, bool thumbnailReady = false); // Upload the thumbnail (downscaled here unless ready)
+    void uploadFocusedStage();
+    void plotStage(const char* label, const std::string& name, float x, float y, float w, float h);
+    bool stageStale(const std::string& name) const; // Whether the thumbnail and metrics of the stage miss changes only applied to the region
+    static uint64_t hashData(const uint8_t* data, size_t size);
+    static void downscaleImage(const uint8_t* inData, uint32_t inW, uint32_t inH, uint8_t* outData, uint32_t outW, uint32_t outH, uint32_t ch);
+
+    // Region of interest
+    void processRegion(size_t lastStage, const Region& region); // Run the stages up to lastStage on the part of the frame that region needs
+
+    // Counter-based random numbers. The result only depends on (key, counter), so any element can be generated independently of the others,
+    // in any order and from any thread
+    static uint32_t randomHash(uint32_t key, uint32_t counter);
+    static float randomNormal(uint32_t key, uint32_t counter); // Approximately standard normal
+
+    // Split [0, count) into contiguous ranges and process each range in a different thread. Nested calls run in the calling thread
+    static void parallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& func);
+    static void parallelForPixels(size_t pixels, const std::function<void(size_t begin, size_t end)>& func); // parallelFor on blocks of pixels
+    static void runSerial(const std::function<void()>& func); // Run func in the calling thread, with its parallel loops running serially
+
+    // Sampling of the CH channels of a pixel, with the interpolation mode and the channel count known at compile time. Interleaved buffers use
+    // step = ch, planar buffers use step = 1 and the plane size as channel stride
+    enum class Interpolation { NEAREST = 0, BILINEAR };
+    template <Interpolation MODE, uint32_t CH, typename Step>
+    static std::array<float, CH> samplePixel(const uint8_t* data, uint32_t w, uint32_t h, Step step, float x, float y, size_t channelStride);
+    template <Interpolation MODE, typename Step>
+    static float sampleChannel(const uint8_t* data, uint32_t w, uint32_t h, Step step, float x, float y); // Single channel
+
+    // Conversion between interleaved and planar frames
+    static void interleavedToPlanar(const uint8_t* inData, uint8_t* outData, size_t pixels, uint32_t ch);
+    static void planarToInterleaved(const uint8_t* inData, uint8_t* outData, size_t pixels, uint32_t ch);
+
+    // Conversion between an image and a frame with a different number of channels and/or layout. Mono frames are the luma of the image and are
+    // displayed as gray, RGBA frames get an opaque alpha channel (unless the image has one) and their alpha channel is not displayed
+    static void imageToFrame(const uint8_t* imageData, uint32_t imageCh, uint8_t* frameData, uint32_t ch, size_t pixels, bool planar);
+    static void frameToImage(const uint8_t* frameData, uint32_t ch, bool planar, uint8_t* imageData, uint32_t imageCh, size_t pixels);
+
+    // Memory accounting
+    struct AllocationCount;
+    struct MemoryEntry;
+    static AllocationCount allocationCount(); // Heap allocations made through TrackedAllocator since the project was loaded
+    std::vector<MemoryEntry> memoryFootprint() const;
+    void logMemoryReport() const;
+    static bool resetPeakResidentMemory();    // Restart the peak resident memory measurement (false if not supported)
+    static size_t residentMemory(bool peak);  // Current or peak resident memory of the process (bytes)
+
+    //---------- Memory setup ----------//
+    // Many pipeline instances run per host, so the memory held by each stage and the allocations of a run are reported. Heap buffers of the
+    // pipeline (frame buffers, dead pixel list, color LUT and the scratch buffers of the stages and metrics) use TrackedAllocator, which counts
+    // the allocations in process-wide atomic counters. The counters are read before and after each stage, so the count of a stage includes
+    // the allocations of its worker threads. Allocations made outside the pipeline (Atta, ImGui, thread startup) are not counted.
+    //
+    // The bytes held are computed from the sizes of the stage images, thumbnails, tables and caches. The peak resident memory of a reprocess
+    // is measured by resetting the peak counter of the process before running the stages (Linux), otherwise it is the peak since startup.
+    struct AllocationCount {
+        uint64_t count = 0; // Number of allocations
+        uint64_t bytes = 0; // Bytes allocated
+        AllocationCount operator-(const AllocationCount& other) const { return {count - other.count, bytes - other.bytes}; }
+    };
+    static inline std::atomic<uint64_t> _allocationCount{0};
+    static inline std::atomic<uint64_t> _allocationBytes{0};
+    template <typename T>
+    struct TrackedAllocator {
+        using value_type = T;
+        TrackedAllocator() = default;
+        template <typename U>
+        TrackedAllocator(const TrackedAllocator<U>&) {}
+        T* allocate(size_t n) {
+            _allocationCount.fetch_add(1, std::memory_order_relaxed);
+            _allocationBytes.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+            return std::allocator<T>().allocate(n);
+        }
+        void deallocate(T* p, size_t n) { std::allocator<T>().deallocate(p, n); }
+        template <typename U>
+        bool operator==(const TrackedAllocator<U>&) const { return true; }
+        template <typename U>
+        bool operator!=(const TrackedAllocator<U>&) const { return false; }
+    };
+    template <typename T>
+    using TrackedVector = std::vector<T, TrackedAllocator<T>>;
+
+    struct MemoryEntry {
+        std::string name;
+        std::string kind; // "image", "thumbnail", "buffer", "table", "cache" or "mapped" (file pages, resident when accessed)
+        size_t bytes = 0; // Bytes held
+    };
+    std::vector<std::pair<std::string, AllocationCount>> _stageAllocations; // Allocations of each stage in the last reprocess (and preparation)
+    std::vector<MemoryEntry> _memoryFootprint;                              // Bytes held after the last reprocess
+    size_t _peakResidentMemory = 0;        // Peak resident memory during the last reprocess (bytes)
+    bool _peakResidentMemoryReset = false; // Whether the peak was measured for the last reprocess only (otherwise since startup)
+    bool _logMemory = true;                // Log the memory summary after each reprocess
+
+    //---------- Display setup ----------//
+    // Most stages are drawn as small thumbnails in the pipeline plot, so uploading every full resolution texture after each reprocess wastes
+    // bandwidth. Each stage image has a downscaled copy (suffix "_thumb") that is uploaded only when the stage output changes. A parameter
+    // change marks the outputs from the first stage that reads it as changed (the earlier stages produce the same output), so no stage image
+    // is read to detect changes. The full resolution texture is uploaded only for the stage under the cursor, and only when the plot is
+    // zoomed in enough to magnify the thumbnail.
+    static constexpr uint32_t THUMBNAIL_MAX_SIZE = 256; // Maximum thumbnail width/height in pixels
+    struct StageDisplay {
+        bool fullUploaded = false; // Whether the full resolution texture matches the stage data
+    };
+    size_t _firstDirtyStage = 0; // First stage whose output changed since the last reprocess (_stages.size() if none)
+    bool _referenceDirty = true; // Whether the reference changed since the last reprocess
+    std::map<std::string, StageDisplay> _stageDisplay;
+    std::vector<std::string> _stageNames; // Stage images in pipeline order
+    std::string _focusedStage; // Stage displayed at full resolution (empty if none)
+
+    // Plot rectangle of each stage plotted in the current frame (used for hit testing)
+    struct PlotRect {
+        std::string name;
+        float x, y, w, h;
+    };
+    std::vector<PlotRect> _plotRects;
+
+    //---------- Region of interest setup ----------//
+    // When the plot is zoomed in on a stage, only the visible part of that stage is needed. With region of interest evaluation, a reprocess
+    // runs the stages up to the inspected one on the visible region plus a margin, grown back through the halo of each stage like the
+    // out-of-core tiles (for the warp stages, the largest displacement of the inverse mapping inside the region). Only those parts of the
+    // stage images are updated, so the region is processed again when the view leaves it, and the whole frame when the plot is zoomed out.
+    // Metrics, scaled outputs and thumbnails are only updated by whole frame reprocesses, so after a region reprocess with changes (from
+    // _firstDirtyStage on, or of the reference) they are stale until the plot is zoomed out: the thumbnails are labeled as stale, and the
+    // metrics and scaled outputs of the changed stages are hidden.
+    static constexpr uint32_t ROI_MARGIN = 64; // Pixels processed around the visible region, so small pans do not reprocess
+    bool _roiEvaluation = true;
+    Region _viewRegion;       // Visible region of the focused stage (empty if no stage is focused)
+    Region _roiRegion;        // Region of _roiStage computed by the last region reprocess
+    size_t _roiStage = 0;     // Index of the last stage computed by the last region reprocess
+    bool _roiPartial = false; // Whether the stage images were only partially updated by the last reprocess
+
+    //---------- Image quality metrics setup ----------//
+    // After each reprocess, every stage output is compared against the reference image. PSNR is computed per channel, SSIM is computed on the
+    // luma channel with a box window (sliding sums, so the cost does not depend on the window size), and ΔE is the mean CIEDE2000 difference.
+    // CIEDE2000 is much more expensive than the other metrics, so it is evaluated on a subsampled grid.
+    bool _computeMetrics = true;
+    static constexpr uint32_t SSIM_WINDOW = 8;   // SSIM window size (pixels)
+    static constexpr uint32_t DELTA_E_STRIDE = 2; // Sampling stride (in each direction) used for CIEDE2000
+    std::vector<std::pair<std::string, ImageMetrics>> _stageMetrics;
+    float _pipelineTime = 0.0f; // Time spent running the pipeline in the last reprocess (ms)
+    float _metricsTime = 0.0f;  // Time spent computing the metrics in the last reprocess (ms)
+
+    //---------- Frame layout setup ----------//
+    // The stages can run on interleaved frames (RGBRGB..., the layout of the images) or planar frames (RR...GG...BB...). With planar frames
+    // the reference is converted once before the first stage and every stage reads and writes planes, so per-channel operations run as
+    // contiguous loops over a plane row, and stages that only change some channels (chromatic aberration) only sample those planes. The stage
+    // outputs are interleaved into the stage images only for display.
+    //
+    // Frames can also have 1 (mono), 3 (RGB) or 4 (RGBA) channels. Each stage dispatches once on the channel count and the layout, and runs a
+    // kernel where both are compile-time constants. Mono frames use the parameters of the green channel, and the alpha channel of RGBA frames
+    // is copied by the color stages and resampled by the warp stages.
+    bool _planarLayout = false;
+    uint32_t _frameChannels = 3;
+    std::array<TrackedVector<uint8_t>, 2> _stageFrames; // Stage input and output when the frames differ from the images (layout or channels)
+
+    // Interpolation used by the warp stages (lens distortion and chromatic aberration). It is also dispatched once per stage call
+    Interpolation _interpolation = Interpolation::BILINEAR;
 
     //----------  Image degradation pipeline setup ----------//
     //--- White balance error ---//
@@ -99,6 +438,15 @@ class Project : public scr::ProjectScript {
     // V(r) = a⋅r^4 + b⋅r^3 + c⋅r^2 + d⋅r + e
     std::array<float, 5> _vignettingCoeffs = {-0.5f, 0.0f, 0.0f, -0.2f, 1.0f}; // Coefficients for the vignetting polynomial (a, b, c, d, e)
 
+    //--- Sensor noise ---//
+    // Poisson-Gaussian noise model applied to every pixel. Shot noise has a variance proportional to the signal, and read noise has a constant
+    // variance, so the noisy value is approximated by x + sqrt(a⋅x + b^2)⋅n, with n ~ N(0, 1), a the shot noise gain (DN per electron) and b
+    // the read noise standard deviation (DN). The normal samples come from a counter-based generator, so the noise is deterministic for a
+    // given seed no matter how the image is split between threads.
+    float _shotNoiseGain = 0.3f; // Shot noise gain (a)
+    float _readNoise = 2.0f;     // Read noise standard deviation (b)
+    int _sensorNoiseSeed = 42;
+
     //--- Black level offset ---//
     uint8_t _blackLevelOffset = 20;
 
@@ -112,8 +460,7 @@ class Project : public scr::ProjectScript {
     // frames.
     //
     // A list of dead pixels should be generated during the dead pixel calibration process. The stored list can later be used during the dead pixel
-    // correction process, which will interpolate the values of the neighboring pixels.
-    std::vector<uint32_t> _deadPixels; // List of dead pixels in the image (index in the image buffer)
+    // correction process, which will interpolate the values of the neighboring pixels. The list is part of the camera module (CameraModule).
 
     //--- Black level correction ---//
     // The image sensor may have optical black (OB) pixels, in this case, we can just subtract the average value of the optical black pixels from the
@@ -124,29 +471,369 @@ class Project : public scr::ProjectScript {
     // exposure time.
     //
     // For the sake of this implementation, we'll assume that the camera sensor has 10 optical black pixels. Gaussian noise will be
-    // added to the black pixels during the degradation stage.
-    std::array<atta::vec3, 10> _obPixels;
+    // added to the black pixels during the degradation stage. The measurements are part of the camera module (CameraModule).
+
+    //--- Noise reduction ---//
+    // Noise reduction is applied right after black level correction, while the noise is still independent between pixels. Two edge-preserving
+    // filters are available:
+    // - Bilateral grid: the image is splatted into a coarse 3D grid (x, y, intensity), blurred, and sliced back with trilinear interpolation.
+    //   The cost is independent of the filter size, so it is the fast mode.
+    // - Non-local means: each pixel is the weighted average of the pixels in a search window, weighted by the similarity of the patches around
+    //   them. Instead of comparing every pair of patches, the squared difference image is computed once per search offset and box-filtered, so
+    //   the patch distance costs O(1) per pixel regardless of the patch size.
+    // The quality knob (1 to 5) trades speed for quality: it shrinks the bilateral grid cells and grows the NLM search window and patch.
+    enum class NoiseReductionMode { NONE = 0, BILATERAL_GRID, NON_LOCAL_MEANS };
+    NoiseReductionMode _noiseReductionMode = NoiseReductionMode::BILATERAL_GRID;
+    float _noiseReductionStrength = 10.0f; // Range sigma (bilateral grid) or filtering parameter h (NLM), in intensity levels
+    int _noiseReductionQuality = 2;        // Quality/speed knob (1 = fastest, 5 = best quality)
+    float _noiseReductionTime = 0.0f;      // Time spent in the last noise reduction (ms)
 
-    //--- Vignetting correction ---//
-    // The vignetting correction will be done by applying the inverse of the vignetting polynomial to the image. Since the vignetting effect is
-    // determined by the lens/physical design, the vignetting calibration can be done once per camera design (or once for each camera during factory
-    // calibration).
+    // Benchmark time (ms) for each mode (bilateral grid, NLM) and quality level
+    static constexpr int NOISE_REDUCTION_QUALITY_MAX = 5;
+    std::array<std::array<float, NOISE_REDUCTION_QUALITY_MAX>, 2> _noiseReductionBenchmark{};
+
+    //--- Lens shading correction ---//
+    // Vignetting and color shading are both per-channel gains that vary smoothly across the frame, so they are corrected together by a 2D mesh
+    // of correction gains (LENS_SHADING_MESH_W x LENS_SHADING_MESH_H nodes per channel, like the lens shading blocks of hardware ISPs). Unlike
+    // the radial profile, the mesh can represent off-center and asymmetric shading. It is either fitted by the calibration or derived from the
+    // radial vignetting and color shading profile. Since shading is caused by the lens design, the mesh can be calibrated once per lens design
+    // (or once for each camera during factory calibration).
+    //
+    // The mesh nodes are placed at integer pixel positions and the gains are 16.16 fixed point, clamped to [0, LENS_SHADING_MAX_GAIN]. The
+    // gains of a row are interpolated once between two mesh rows (16.32 fixed point), and then stepped along the row with one integer addition
+    // per pixel (no square root or division). The gain of a pixel is exact, so it does not depend on where the tile starts.
+    static constexpr uint32_t LENS_SHADING_MESH_W = 17;
+    static constexpr uint32_t LENS_SHADING_MESH_H = 13;
+    static constexpr float LENS_SHADING_MAX_GAIN = 255.0f; // Saturates any pixel value above zero
 
     //--- Chromatic aberration correction ---//
     // The chromatic aberration correction will be done by applying the inverse of the chromatic aberration polynomial to the image.
     // Since chromatic aberration is caused by the lens design, the CA correction profile can be calibrated once per lens design (or once for each
     // camera during factory calibration).
 
-    //--- Color shading correction ---//
-    // The color shading correction will be done by applying the inverse of the color shading polynomial to the image.
-    // Since color shading is caused by the lens design, the color shading correction profile can be calibrated once per lens design (or once for
-    // each camera during factory calibration).
-
     //--- Lens correction ---//
     // The lens correction will be done by applying the inverse of the lens distortion polynomial to the image.
 
     //--- White balance correction ---//
     // The white balance correction will be done by applying the inverse of the color temperature gain to the image.
+
+    //--- Scaler ---//
+    // Besides the full resolution output, consumers want a preview and an analytics resolution, and the thumbnails of the last stages are the
+    // same operation at another size. The scaler runs on the output of the white balance correction (before the transfer curve) and produces
+    // every output size from a single read of the frame: bands of input rows are read once, each row is filtered horizontally into a row
+    // buffer per output, and the output rows of the band are filtered vertically from these buffers. The filters are separable Lanczos-2
+    // polyphase filters, widened by the downscale factor so they do not alias, with the coefficients of SCALER_PHASES subpixel phases
+    // precomputed when the sizes change. The stages after the white balance correction then run on each scaled output, which costs much
+    // less than scaling their full resolution output, and the thumbnails of these stages are the thumbnail output of the scaler.
+    struct PolyphaseFilter {
+        uint32_t inSize = 0;
+        uint32_t outSize = 0;
+        uint32_t taps = 0;
+        std::vector<int32_t> start;  // First input index of each output index (indices outside the input are clamped)
+        std::vector<uint32_t> phase; // Phase of each output index
+        std::vector<float> coeffs;   // Coefficients of each phase (taps per phase, normalized to a sum of 1)
+    };
+    struct ScalerOutput {
+        std::string name;      // Output image is "pro_output_" + name, empty for the thumbnail of the stages after the scaler
+        uint32_t maxSize = 0;  // Largest output width/height (the frame is not upscaled)
+        uint32_t w = 0;
+        uint32_t h = 0;
+        PolyphaseFilter filterX;
+        PolyphaseFilter filterY;
+        std::array<TrackedVector<uint8_t>, 2> data; // Scaled frame and the output of the following stages (same layout and channels as the frame)
+    };
+    bool _scalerEnabled = true;
+    std::string _scalerStage = "pro_white_balance"; // Stage whose output is scaled
+    std::vector<ScalerOutput> _scalerOutputs = {
+        {"preview", 1280, 0, 0, {}, {}, {}},
+        {"analytics", 320, 0, 0, {}, {}, {}},
+        {"", THUMBNAIL_MAX_SIZE, 0, 0, {}, {}, {}},
+    };
+    float _scalerTime = 0.0f; // Time spent scaling and processing the scaled outputs in the last reprocess (ms)
+    static constexpr uint32_t SCALER_PHASES = 64;
+    static constexpr float SCALER_LOBES = 2.0f;       // Lanczos filter radius (in output pixels)
+    static constexpr uint32_t SCALER_BAND_ROWS = 128; // Input rows read by each parallel job
+
+    //--- Color correction ---//
+    // The final color stage applies the color correction matrix (CCM), the transfer curve (gamma) and the tone curve. Instead of evaluating
+    // them per pixel, they are baked into a 3D LUT when the parameters change, so the per-pixel cost is a single table lookup with
+    // tetrahedral interpolation no matter how many operations are active. The LUT can also be loaded from a .cube file.
+    //
+    // A built LUT only holds the CCM, unclamped, and the clamping, transfer curve and tone curve are applied after the interpolation by an
+    // output LUT indexed by the 16-bit interpolated value (shared by the channels). The CCM is linear, so the tetrahedral interpolation is
+    // exact, and the steep part of the curves near black and the clamping of out of gamut colors are not interpolated between the nodes.
+    //
+    // When the CCM is the identity and no LUT file is loaded, the channels are independent, so a 256-entry 1D LUT per channel is used
+    // instead. The sRGB curve table is generated at compile time.
+    std::array<float, 9> _colorCorrectionMatrix = {1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}; // Row major
+    enum class TransferCurve { LINEAR = 0, SRGB, GAMMA };
+    TransferCurve _transferCurve = TransferCurve::LINEAR;
+    float _gamma = 2.2f;        // Encoding gamma when using TransferCurve::GAMMA
+    float _toneContrast = 0.0f; // Strength of the tone S-curve (0 = no tone mapping, negative values reduce contrast)
+    int _colorLutSize = 33;     // Grid points per axis when building the 3D LUT (17, 33 or 65)
+    bool _colorLutDirty = true; // Whether the LUTs should be rebuilt before the next reprocess
+
+    enum class ColorLutMode { IDENTITY = 0, CURVE_SRGB, CURVE, LUT_3D };
+    ColorLutMode _colorLutMode = ColorLutMode::IDENTITY;
+    std::string _colorLutFile;                              // Loaded .cube file (empty if the LUT is built from the parameters)
+    uint32_t _colorLutDim = 0;                              // Grid points per axis of the 3D LUT
+    TrackedVector<uint16_t> _colorLut;                      // 3D LUT (RGB, 16-bit fixed point, red index changes fastest like in .cube files)
+    TrackedVector<uint8_t> _colorLutOutput;                 // Output value of each 16-bit 3D LUT value
+    std::array<std::array<uint8_t, 256>, 3> _colorCurve{}; // Per-channel 1D LUT
+
+    //---------- Stage plan setup ----------//
+    // The parameters of the spatially uniform 8-bit stages (white balance error and correction, black level offset and correction) are
+    // compiled by prepareStages into immutable plans. Each of these stages maps every value of a channel through the same function, so its
+    // plan is a 256-entry LUT per channel: the temperature gains and the black level measured from the optical black pixels are derived once
+    // per frame, and the stages only do table lookups. The lens shading plan is the correction mesh for the frame size.
+    using ChannelLuts = std::array<std::array<uint8_t, 256>, 3>;
+    struct LensShadingPlan {
+        std::array<uint32_t, LENS_SHADING_MESH_W> nodeX; // Pixel column of each mesh column
+        std::array<uint32_t, LENS_SHADING_MESH_H> nodeY; // Pixel row of each mesh row
+        std::array<std::array<int32_t, 3>, LENS_SHADING_MESH_W * LENS_SHADING_MESH_H> gains; // Correction gains (16.16 fixed point, row major)
+    };
+    struct StagePlans {
+        ChannelLuts degWhiteBalance;
+        ChannelLuts degBlackLevel;
+        ChannelLuts proBlackLevel;
+        ChannelLuts proWhiteBalance;
+        LensShadingPlan lensShading;
+    };
+
+    // Map the color values of every pixel through the LUT of their channel (mono frames use the green LUT) and copy alpha
+    static void applyChannelLuts(const std::array<const uint8_t*, 3>& luts, const uint8_t* inData, uint8_t* outData, uint32_t ch,
+                                 const Tile& tile);
+    static void applyChannelLuts(const ChannelLuts& luts, const uint8_t* inData, uint8_t* outData, uint32_t ch, const Tile& tile) {
+        applyChannelLuts({luts[0].data(), luts[1].data(), luts[2].data()}, inData, outData, ch, tile);
+    }
+
+    //---------- Calibration setup ----------//
+    // The correction stages can either use the ideal parameters (the same ones used by the degradation pipeline) or a calibrated profile.
+    // The calibration captures test charts through the degradation pipeline (the simulated camera) and fits the correction parameters:
+    // - Vignetting and color shading are fitted from a flat-field capture. Subsampled pixels are accumulated in radial bins (in parallel), and
+    //   the gain of each bin relative to the center is computed. Only the product of vignetting and color shading is observable, so the
+    //   vignetting polynomial is fitted (weighted least squares) to the channel average, and the color shading is the per-channel residual.
+    //   The lens shading mesh is measured directly: each node is the center level over the average of the flat field around the node.
+    // - Chromatic aberration is fitted from a grid chart capture (resources/grid.png). For each tile with enough edges, the radial scale that
+    //   best aligns the red/blue channel to the green channel is found by normalized cross-correlation, and the CA polynomial is fitted to the
+    //   per-tile displacements.
+    // The fitted profile is written to calibration_profile.txt in the project directory, and loaded on startup if it exists.
+    struct CalibrationProfile {
+        std::array<float, 5> vignettingCoeffs;
+        std::array<atta::vec3, COLOR_SHADING_COUNT> colorShading;
+        std::array<float, 2> chromaticAberrationCoeffsR;
+        std::array<float, 2> chromaticAberrationCoeffsB;
+        std::vector<atta::vec3> lensShading; // Correction gain of each mesh node (row major), empty to derive the mesh from the radial profile
+    };
+    bool _shouldCalibrate = false;    // Run calibration in the next loop
+    float _calibrationTime = 0.0f;    // Time spent in the last calibration (ms)
+    static constexpr uint8_t FLAT_FIELD_LEVEL = 100; // Flat-field intensity (low enough to not saturate with the white balance error)
+    static constexpr uint32_t CALIBRATION_RADIAL_BINS = 64;
+    static constexpr uint32_t CALIBRATION_STRIDE = 2; // Pixel subsampling when accumulating the radial bins
+    static constexpr uint32_t CALIBRATION_TILE = 32;  // Tile size for chromatic aberration estimation
+
+    //---------- Camera module setup ----------//
+    // The state read by the stages that depends on the camera module (the sensor and lens): its calibration profile, and the tables prepared
+    // for a frame size. The UI pipeline uses the current module (_camera). Multi-stream processing prepares one module per camera module and
+    // frame size, and its workers run the stages with the module of the stream (runWithCamera), so the streams of different modules run at the
+    // same time while each module is shared read-only by its streams.
+    struct CameraModule {
+        CalibrationProfile calibration{};
+        bool useCalibration = false;                                     // Whether the correction stages use the calibrated profile
+        TrackedVector<uint64_t> deadPixels;                              // Sorted list of dead pixels in the image (index in the frame buffer)
+        std::tuple<uint32_t, uint32_t, uint32_t, float> deadPixelsKey{}; // Frame size, channels and percentage the list was generated for
+        std::array<atta::vec3, 10> obPixels;                             // Optical black pixel measurements
+        StagePlans plans{};
+    };
+    CameraModule _camera;
+    static thread_local const CameraModule* _threadCamera; // Module read by the stages in the calling thread (nullptr for _camera)
+
+    //---------- Out-of-core setup ----------//
+    // Images larger than RAM are processed in tiles, without ever holding the whole frame in memory:
+    // - The input (binary PPM) is memory mapped and converted to a tiled intermediate file in which every tile is contiguous, so reading a
+    //   tile with its halo touches a few pages instead of one page per image row.
+    // - Each output tile is computed by running all stages on shrinking regions. The region read from the tiled input is the output tile grown
+    //   by the halo of every stage, and each stage outputs its input region shrunk by its own halo.
+    // - Output tiles are written to the memory mapped output file, and each band of tiles is flushed and dropped from memory once finished.
+    // Peak RAM is two buffers per thread, each with the size of a tile grown by the halos, no matter the image dimensions. The halos of the
+    // warp stages are their displacement in pixels, so they are small near the image center and largest at the corners.
+    struct MappedFile {
+        uint8_t* data = nullptr;
+        size_t size = 0;
+        int fd = -1;
+
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile() { close(); }
+        bool open(const fs::path& path);                   // Map an existing file (read only)
+        bool create(const fs::path& path, size_t size);    // Create a file with the given size and map it (read/write)
+        void release(size_t offset, size_t length);        // Write back the pages of a byte range (if dirty) and drop them from memory
+        void prefetch(size_t offset, size_t length) const; // Start reading the pages of a byte range in the background
+        void close();
+    };
+
+    // Image stored as a grid of tiles after a page-aligned header. Tiles are stored in row major order, each tile is row major and edge tiles
+    // are padded to the full tile size
+    struct TiledImage {
+        static constexpr size_t HEADER_SIZE = 4096;
+        MappedFile file;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t channels = 0;
+        uint32_t tileSize = 0;
+        uint32_t tilesX = 0;
+        uint32_t tilesY = 0;
+
+        bool create(const fs::path& path, uint32_t w, uint32_t h, uint32_t ch, uint32_t size);
+        size_t tileBytes() const { return size_t(tileSize) * tileSize * channels; }
+        uint8_t* tile(uint32_t tx, uint32_t ty) const { return file.data + HEADER_SIZE + (size_t(ty) * tilesX + tx) * tileBytes(); }
+        void readRegion(const Region& region, uint8_t* outData) const; // Copy a region of the image to a row major buffer
+    };
+
+    bool _shouldProcessOutOfCore = false; // Run out-of-core processing in the next loop
+    std::string _outOfCoreInput;          // Input image (binary PPM)
+    std::string _outOfCoreOutput;         // Output image (binary PPM)
+    int _outOfCoreTileSize = 512;         // Output tile size (pixels)
+    float _outOfCoreTime = 0.0f;          // Time spent in the last out-of-core run (ms)
+    size_t _outOfCoreBufferSize = 0;      // Largest tile buffer used in the last out-of-core run (bytes)
+
+    //---------- Batch setup ----------//
+    // Dataset generation pushes many independent images through the pipeline, so batch processing runs one image per worker thread (with
+    // the stage loops running serially) instead of one image at a time split between threads:
+    // - The calling thread decodes the inputs (binary PPM/PGM) into a fixed pool of frame slots, so at most BATCH_PREFETCH_FRAMES frames per
+    //   worker are decoded ahead, and a writer thread encodes the outputs (binary PPM) and returns their slots to the pool.
+    // - Decoded frames are pushed round-robin to per-worker queues. A worker takes the newest frame of its own queue and, when it is empty,
+    //   steals the oldest frame of another queue, so a worker that got expensive images does not hold frames the others could process.
+    // - Each worker owns an arena of two frame buffers (stage input and output) sized to the largest input, and the slots have the same
+    //   size, so no frame memory is allocated per image.
+    // The stage state (dead pixels) depends on the frame size, so the inputs are sorted by size and the stages are prepared once per size.
+    bool _shouldProcessBatch = false;              // Run batch processing in the next loop
+    std::string _batchInput;                       // Input directory
+    std::string _batchOutput;                      // Output directory
+    std::string _batchOutputStage = "deg_output"; // Stage whose output is written (later stages are skipped)
+    int _batchWorkers = 0;                         // Worker threads (0 = one per hardware thread)
+    size_t _batchImages = 0;                       // Images processed in the last batch run
+    size_t _batchSteals = 0;                       // Frames taken from the queue of another worker in the last batch run
+    float _batchTime = 0.0f;                       // Time spent in the last batch run (ms)
+    static constexpr uint32_t BATCH_PREFETCH_FRAMES = 2;
+
+    //---------- Input setup ----------//
+    // Frames are ingested without an image decoder when possible:
+    // - Files (PPM/PGM, Y4M or raw) are memory mapped and the offset of every frame is indexed when opening, so a frame is converted from the
+    //   mapping straight into the reference image (a single memcpy for RGB frames), and the next frame is prefetched while it is processed.
+    // - Streams (stdin or a FIFO) are polled every loop without blocking. Once a frame starts arriving it is read with blocking reads, RGB
+    //   frames directly into the reference image and other formats into a staging buffer that is converted in a single pass.
+    // Raw inputs have no header, so their layout is set in the UI. Other image files (PNG, JPG) are decoded by Atta.
+    enum class PixelFormat { RGB = 0, GRAY, BAYER_RGGB, YUV420, YUV444, YUV400 }; // YUV formats are planar BT.601 limited range
+    struct FrameLayout {
+        PixelFormat format = PixelFormat::RGB;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        size_t size() const; // Frame size in bytes
+    };
+    enum class InputContainer { NONE = 0, IMAGE, PNM, Y4M, RAW };
+    InputContainer _inputContainer = InputContainer::NONE;
+    FrameLayout _inputLayout;                             // Layout of the current frame
+    FrameLayout _rawLayout{PixelFormat::RGB, 640, 480};   // Layout of raw inputs
+    MappedFile _inputFile;                                // Mapped input file
+    std::vector<size_t> _inputFrames;                     // Offset of the data of each frame in the mapped file
+    int _inputFrame = 0;                                  // Current frame of the mapped file
+    bool _inputPlay = false;                              // Advance one frame per loop
+    int _inputFd = -1;                                    // Input stream (-1 if the input is not a stream)
+    std::string _inputPending;                            // Bytes read ahead from the stream when detecting its container
+    std::vector<uint8_t> _inputStaging;                   // Stream frame before the conversion to RGB
+    float _inputTime = 0.0f;                              // Time spent reading the last frame (ms)
+    static constexpr size_t INPUT_MAX_HEADER_SIZE = 1024; // Longest PNM/Y4M header accepted from a stream
+
+    //---------- Multi-stream setup ----------//
+    // Camera rigs run several streams through the pipeline at the same time. Each stream has its own context (mapped input file, frame index,
+    // current frame, output file and statistics), while the state read by the stages is prepared once and shared read-only by the streams of
+    // the same camera module. Streams are grouped by calibration profile and frame size, and each group gets its own CameraModule (calibration
+    // profile, dead pixel list, optical black pixels, stage plans), so the tables are never duplicated per stream. The color LUT does not
+    // depend on the camera module and is shared by all the streams.
+    //
+    // Worker threads (one per core by default, at most one per stream) run the streams of all the groups together. A free worker takes the
+    // next frame of the stream that processed the fewest frames among the streams no other worker is processing, so the frames of a stream are
+    // processed and written in order, the streams advance at the same rate and no core waits while a stream has frames left. Stage loops run
+    // serially in the workers with the camera module of the stream, and each worker owns an arena of two frame buffers (like batch processing).
+    struct StreamContext {
+        std::string input;                    // Multi-frame file (PPM/PGM, Y4M or raw)
+        std::string calibration;              // Calibration profile of the camera module (empty to use the current profile)
+        const CameraModule* camera = nullptr; // Stage state of the camera module, shared by the streams of the group
+        MappedFile file;                      // Mapped input file
+        FrameLayout layout;                   // Layout of the input frames
+        std::vector<size_t> frames;           // Offset of the data of each frame in the mapped file
+        std::vector<uint8_t> frame;           // Frame being processed (RGB input, replaced by the output)
+        std::ofstream output;                 // Output frames (concatenated binary PPM)
+        size_t next = 0;                      // Next frame to process
+        bool busy = false;                    // Whether a worker is processing a frame of the stream
+        bool failed = false;                  // Whether the stream could not be opened, calibrated or written
+        float time = 0.0f;                    // Time spent processing the frames of the stream (ms)
+    };
+    struct StreamResult {
+        std::string input;
+        size_t frames = 0; // Frames processed
+        float time = 0.0f; // Time spent processing the frames (ms)
+        bool failed = false;
+    };
+    bool _shouldProcessStreams = false;            // Run multi-stream processing in the next loop
+    std::vector<std::string> _streamInputs;        // Streams ("file" or "file, calibration profile")
+    std::string _streamOutput;                     // Output directory
+    std::string _streamOutputStage = "pro_output"; // Stage whose output is written (later stages are skipped)
+    int _streamWorkers = 0;                        // Worker threads (0 = one per hardware thread)
+    std::vector<StreamResult> _streamResults;      // Statistics of each stream in the last run
+    float _streamTime = 0.0f;                      // Time spent in the last run (ms)
+
+    //---------- Equivalence harness setup ----------//
+    // Each stage has a reference implementation (the ref* functions): plain scalar code on full interleaved RGB frames, taken from the
+    // original stage functions (or from the first implementation of the stages added later). The references are frozen, optimizations only
+    // change the stage functions. Every way of running a stage function (serial, threaded, planar, tiled, RGBA) is registered as a variant and
+    // is compared with the reference on the bundled images (downscaled) and on randomized synthetic images with odd sizes, edges, noise and
+    // saturated values. Each variant stage receives the reference input of the stage, so differences do not accumulate along the pipeline and
+    // are reported for the stage that caused them. The tolerances are declared per stage: zero for exact stages, and the approximation error
+    // for stages whose implementation approximates the reference (the lens shading mesh and the color LUTs).
+    //
+    // The harness also checks golden checksums of the outputs of the stages computed in integer arithmetic (GOLDEN_STAGES), in the reference
+    // pipeline and in the stage pipeline, run with the default parameters on the synthetic images, so any change of these outputs is
+    // detected. Each of these stages reads the synthetic image itself instead of the output of the previous stage, so the checksums do not
+    // depend on the floating point code generated by the compiler (contraction into FMAs, vectorization) or on the libm of the platform. The
+    // floating point stages are covered by the comparison with their reference and its tolerance. The checksums are committed in
+    // golden_checksums.txt in the project directory and are only written by "Update golden checksums", which is used when an output changes on
+    // purpose.
+    struct EquivalenceVariant {
+        std::string name;
+        // Run the stage on the interleaved RGB frame inData and write the interleaved RGB frame outData
+        std::function<void(const Stage& stage, const uint8_t* inData, uint8_t* outData, uint32_t w, uint32_t h)> run;
+    };
+    struct ReferenceStage {
+        std::string name; // Name of the stage it is the reference of
+        ReferenceFunc func;
+        uint32_t maxTolerance = 0;  // Largest absolute difference accepted for a value
+        float meanTolerance = 0.0f; // Largest mean absolute difference accepted for a stage output
+    };
+    struct EquivalenceResult {
+        std::string variant;
+        std::string stage;
+        std::string input;     // Input with the largest difference
+        uint32_t maxDiff = 0;  // Largest absolute difference over all inputs
+        float meanDiff = 0.0f; // Largest mean absolute difference over all inputs
+        bool passed = true;
+    };
+    bool _shouldVerify = false;          // Run the equivalence harness in the next loop
+    bool _updateGoldenChecksums = false; // Overwrite the golden checksums with the current reference
+    std::vector<EquivalenceResult> _equivalenceResults;
+    uint32_t _goldenMismatches = 0; // Stage outputs that did not match the golden checksums in the last run
+    float _verifyTime = 0.0f;       // Time spent in the last run (ms)
+    static constexpr uint32_t EQUIVALENCE_MAX_SIZE = 512; // Bundled images are downscaled to fit this width/height
+    static constexpr uint32_t EQUIVALENCE_TILE_SIZE = 64; // Output tile size of the tiled variant
+    static constexpr std::array<std::array<uint32_t, 2>, 4> EQUIVALENCE_SYNTHETIC_SIZES = {{{257, 131}, {64, 64}, {131, 257}, {320, 17}}};
+    // Stages with golden checksums (integer arithmetic only, the black level correction reads optical black pixels generated with libm)
+    static constexpr std::array<const char*, 5> GOLDEN_STAGES = {"deg_black_level", "deg_dead_pixel", "deg_output", "pro_dead_pixel", "pro_output"};
+    static constexpr uint32_t LENS_SHADING_TOLERANCE = 1;           // Lens shading mesh gains rounded to 16.16 fixed point
+    static constexpr float LENS_SHADING_MEAN_TOLERANCE = 0.01f;
+    static constexpr uint32_t COLOR_LUT_TOLERANCE = 2;              // Rounding of the 16-bit 3D LUT values (near black with the gamma curve)
+    static constexpr float COLOR_LUT_MEAN_TOLERANCE = 0.05f;
 };
 
 ATTA_REGISTER_PROJECT_SCRIPT(Project)